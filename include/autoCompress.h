@@ -0,0 +1,84 @@
+//
+//  autoCompress.h
+//  keyReducer
+//
+//
+
+#ifndef keyReducer_autoCompress_h
+#define keyReducer_autoCompress_h
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MGlobal.h>
+#include <maya/MCallbackIdArray.h>
+#include <maya/MObjectArray.h>
+#include <maya/MObjectHandle.h>
+#include <maya/MAnimCurveChange.h>
+
+#include <map>
+#include <string>
+
+#include "reductionCache.h"
+
+/*
+ Reduces the animation curves of the scene before it is saved or exported.
+ Only the curves with a true tcAutoReduce attribute and the ones in the given namespace are reduced,
+ and the curves edited since they were last compressed when dirty is on. Curves unchanged since
+ they were last compressed are skipped.
+ On save the pass runs as tcKeyReducerAutoCompress -run, so it goes in the undo queue like any other edit.
+ The settings are stored in option vars so they survive between sessions.
+ */
+class AutoCompress
+{
+public:
+    static MStatus addCallbacks();
+    static void removeCallbacks();
+
+    static void loadSettings();
+    static void saveSettings();
+
+    // reduces the matching curves, stops as soon as the time budget is used.
+    // The edits are recorded in change.
+    static void compress(MAnimCurveChange &change);
+
+    static bool enabled;
+    static double deviation;
+    static MString curveNamespace;
+    static bool dirtyCurves;
+    static double timeBudget;
+
+private:
+    static void beforeSave(void *clientData);
+    static void curvesEdited(MObjectArray &curves, void *clientData);
+
+    static MCallbackIdArray callbacks;
+    // curves edited since they were last compressed, by hash code of their handle
+    static std::map<unsigned int, MObjectHandle> editedCurves;
+    // hash of every curve after it was last compressed
+    static std::map<std::string, CurveHash> compressedCurves;
+};
+
+class AutoCompressCmd: public MPxCommand
+{
+public:
+    AutoCompressCmd();
+    ~AutoCompressCmd(){}
+
+    MStatus doIt(const MArgList&);
+    bool isUndoable() const;
+    MStatus undoIt();
+    MStatus redoIt();
+
+    static MSyntax syntaxCreator();
+
+    static void* creator();
+
+private:
+    // only -run edits the scene, the settings are not undone
+    bool compressed;
+    MAnimCurveChange animCurveChange;
+};
+
+#endif
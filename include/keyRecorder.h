@@ -0,0 +1,61 @@
+//
+//  keyRecorder.h
+//  keyReducer
+//
+//
+
+#ifndef keyReducer_keyRecorder_h
+#define keyReducer_keyRecorder_h
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MGlobal.h>
+#include <maya/MPlug.h>
+#include <maya/MObject.h>
+#include <maya/MObjectHandle.h>
+
+#include <vector>
+
+#include "keyReducerCore.h"
+
+// The handles tell when the node of the attribute or the new curve is gone, deleted or
+// removed with the scene, the plug and the curve can't be used any more then
+class RecordedCurve
+{
+public:
+    MPlug plug;
+    MObjectHandle node;
+    MObjectHandle curve;
+    StreamReducer reducer;
+};
+
+/*
+ Records the given attributes on new animation curves, one sample per call, reducing them
+ while recording so only the keys that can't change anymore are written to the curves.
+ */
+class KeyRecorderCmd: public MPxCommand
+{
+public:
+    KeyRecorderCmd();
+    ~KeyRecorderCmd(){}
+
+    MStatus doIt(const MArgList&);
+    bool isUndoable() const;
+
+    static MSyntax syntaxCreator();
+
+    static void* creator();
+
+    static std::vector<RecordedCurve> recordedCurves;
+
+private:
+    MStatus begin(const MArgList &args, const double deviation);
+    void dropDeletedCurves();
+    void sample(const double time);
+    void end();
+    void addKey(const RecordedCurve &recorded, const double time, const double value);
+};
+
+#endif
@@ -16,14 +16,44 @@
 #include <maya/MGlobal.h>
 #include <maya/MAnimCurveChange.h>
 #include <maya/MFnAnimCurve.h>
+#include <maya/MPlugArray.h>
+#include <maya/MDoubleArray.h>
+#include <maya/MStringArray.h>
+#include <maya/MDGModifier.h>
+#include <maya/MObjectArray.h>
+#include <maya/MMessage.h>
+#include <maya/MCallbackIdArray.h>
 
+#include <map>
+#include <string>
 #include <vector>
 
+#include "keyReducerCore.h"
+
+// Keys of a curve before its first incremental reduction, updated with every edited span,
+// and the time span of the keys edited since the last reduction, in ui units.
+// numKeys is the count of keys the curve should have after the edits seen, when the curve has
+// another count it was changed without them and is reduced from scratch
+class IncrementalSource
+{
+public:
+    double deviation;
+    CurveSamples dense;
+    bool edited;
+    double editStart, editEnd;
+    unsigned int numKeys;
+};
+
+class WindowSeam;
+class CurveJob;
+class ReduceTask;
+class ReduceQueue;
+
 class KeyReducerCmd: public MPxCommand
 {
 public:
     KeyReducerCmd();
-    ~KeyReducerCmd(){}
+    ~KeyReducerCmd();
     
     MStatus doIt(const MArgList&);
     bool isUndoable() const;
@@ -34,23 +64,84 @@ public:
     
     static void* creator();
     
+    static std::map<std::string, IncrementalSource> incrementalSources;
+
+    // the keyframe edits of the curves with an incremental source mark their edited span,
+    // the sources are forgotten when a scene is opened or a new one is created
+    static MStatus addCallbacks();
+    static void removeCallbacks();
+    
 private:
     
-    void keyReduce(MFnAnimCurve &curve);
+    // the keys in the time range are contiguous, from firstKey for numKeys keys
+    bool collectKeys(MFnAnimCurve &curve, unsigned int &firstKey, unsigned int &numKeys);
+    bool collectKeys(MFnAnimCurve &curve, MIntArray &keyIndexes);
+    bool prepareCurve(MFnAnimCurve &curve, unsigned int &firstKey, unsigned int &numKeys);
+    bool prepareCurve(MFnAnimCurve &curve, MIntArray &keyIndexes);
+    void pipelineKeyReduce(const MPlugArray &plugs);
+    bool startJob(MFnAnimCurve &curve, CurveJob &job);
+    void readWindow(CurveJob &job, ReduceTask &task, ReduceQueue &queue);
+    bool writeWindows(CurveJob &job, std::vector<ReduceTask> &tasks, std::vector<unsigned int> &freeTasks);
+    static void keyframesEdited(MObjectArray &deltas, void *clientData);
+    static void sceneChanged(void *clientData);
+    void incrementalKeyReduce(MFnAnimCurve &curve);
+    void reduceDirtySpan(MFnAnimCurve &curve, IncrementalSource &source);
+    unsigned int keyBudget(const unsigned int numKeys);
+    void budgetKeyReduce(const MPlugArray &plugs, const bool group, MDoubleArray &result);
+    unsigned int applyBudgetTolerance(const MPlug &plug, const MIntArray &keyIndexes, const double tolerance);
+    void undoBudgetChanges(const unsigned int first);
+    void levelsKeyReduce(const MPlugArray &plugs, MStringArray &result);
     bool isAfterStartTime(const MTime &time);
     bool isBeforeEndTime(const MTime &time);
     void doKeyReduce(const MIntArray &sourceKeys, const MFnAnimCurve &fnCurve, MIntArray &outKeys);
-    void addIndex(MIntArray &array, const int index);
-    int getIndexInArray(const MIntArray &array, const int &val);
-    void getBoundaries(const MIntArray &keys, const MFnAnimCurve &fnCurve, const int &currentIndex, double &x1, double &y1,double &x2, double &y2);
-    double getValue(const double &x1, const double &y1, const double &x2, const double &y2, const double &x3, const double &y3);
+    void doWindowedKeyReduce(const MIntArray &sourceKeys, const MFnAnimCurve &fnCurve, MIntArray &outKeys);
+    void appendWindowKeys(const int firstKey, const CurveSamples &samples, const std::vector<int> &keptKeys,
+                          WindowSeam &seam, MIntArray &outKeys);
+    bool isSeamRedundant(const WindowSeam &seam, const CurveSamples &samples, const int nextKey);
     void sampleCurve(MFnAnimCurve &curve);
+    void updateScratchStats();
     
     MAnimCurveChange animCurveChange;
+    // one per curve reduced to a key budget, after the edits recorded in animCurveChange
+    std::vector<MAnimCurveChange *> budgetChanges;
+    MDGModifier dgModifier;
     int startTime, endTime;
     bool hasStartTime, hasEndTime;
     double deviation;
     bool preBake;
+    int windowSize;
+    int maxKeys;
+    double keyRatio;
+    std::vector<double> levels;
+    
+    // buffers reused by all the curves of the command, one more set per thread for the windows and the workers
+    ReduceScratch scratch;
+    std::vector<ReduceScratch> windowScratch;
+    MIntArray curveKeys, reducedKeys;
+    unsigned int scratchAllocations;
+    size_t scratchPeakBytes;
+
+    static MCallbackIdArray callbacks;
+    // set while the command flushes the edits it made itself
+    static bool ignoreEdits;
 };
 
+// True if the key has a stepped out tangent
+bool isSteppedKey(const MFnAnimCurve &fnCurve, const unsigned int index);
+
+// Copies the keys from firstKey to lastKey, both included, into samples
+void snapshotKeys(const MFnAnimCurve &fnCurve, const unsigned int firstKey, const unsigned int lastKey, CurveSamples &samples);
+
+// Reads the time, value and tangents of a key, as copyKeys writes them
+void readKey(const int index, const MFnAnimCurve &fnSource, KeyData &key);
+
+// True if thisValue is closer than aroundValue to value
+bool aroundThisValue(const double thisValue, const double value, const double aroundValue);
+
+// Adds the keys to fnDest with their tangents, reading them all first
+void copyKeys(const MIntArray &keys, const MFnAnimCurve &fnSource, MFnAnimCurve &fnDest, MAnimCurveChange *change, ReduceScratch &scratch);
+
+// Replaces the keys of the curve between the first and the last kept key with the kept ones
+void applyReducedKeys(MFnAnimCurve &curve, const MIntArray &keptKeys, MAnimCurveChange *change, ReduceScratch &scratch);
+
 #endif
@@ -0,0 +1,171 @@
+//
+//  keyReducerCore.h
+//  keyReducer
+//
+//
+
+#ifndef keyReducer_keyReducerCore_h
+#define keyReducer_keyReducerCore_h
+
+#include <stddef.h>
+#include <vector>
+
+// Plain copy of the keys to reduce. Times are in ui units, values in curve units.
+// stepped flags the keys with a stepped out tangent, it can be left empty.
+// The reduction works on this data only so it can run outside of Maya's main thread.
+class CurveSamples
+{
+public:
+    std::vector<double> times;
+    std::vector<double> values;
+    std::vector<char> stepped;
+
+    void clear();
+    unsigned int size() const;
+};
+
+// Distance of the point (x3, y3) from the line passing through (x1, y1) and (x2, y2)
+double getDeviation(const double &x1, const double &y1, const double &x2, const double &y2, const double &x3, const double &y3);
+
+// True if the two values are close enough to be the same hold for the flat and stepped detection
+bool isFlatValue(const double &a, const double &b);
+
+/*
+ A span between two kept samples, together with the sample inside it that deviates the most.
+ */
+class ReduceSegment
+{
+public:
+    int start, end;
+    int index;
+    double deviation;
+
+    // the queue pops the biggest deviation first, the earliest sample wins on ties
+    bool operator<(const ReduceSegment &other) const
+    {
+        if (deviation != other.deviation)
+            return deviation < other.deviation;
+        return index > other.index;
+    }
+};
+
+#if defined(MAYA2018)
+typedef double KeyTangentValue;
+#else
+typedef float KeyTangentValue;
+#endif
+
+// A key and its tangents as they are copied from one curve to another.
+// time is in timeUnit, the tangent types are MFnAnimCurve::TangentType.
+class KeyData
+{
+public:
+    double time;
+    int timeUnit;
+    double value;
+    int inTType, outTType;
+    KeyTangentValue inXTangentValue, inYTangentValue, outXTangentValue, outYTangentValue;
+    bool tangentsLocked, weightsLocked;
+};
+
+// Working buffers of the reduction and of the transfer of the kept keys, reused from one curve to
+// the next so a run over many curves only allocates when a curve is longer than the ones before it.
+// Each thread needs its own.
+class ReduceScratch
+{
+public:
+    ReduceScratch();
+
+    CurveSamples samples;
+    std::vector<int> keptKeys;
+    std::vector<double> values;
+
+    std::vector<char> kept;
+    std::vector<char> spanTypes;
+    std::vector<ReduceSegment> segments;
+
+    std::vector<KeyData> keyData;
+    std::vector<unsigned int> newKeyIndexes;
+
+    // counts the buffers grown since the last call, call it once per curve
+    void updateStats();
+
+    unsigned int allocations;
+    size_t reservedBytes;
+
+private:
+    std::vector<size_t> capacities;
+};
+
+// Greedy reduction: starting from the first and last samples, the sample that deviates the most
+// from its enclosing kept samples is kept, until no sample deviates more than the given deviation.
+// A linear pre-pass first leaves the inside of flat holds out of the search, those samples can't
+// deviate more than the ends of their hold, and keeps only the pose changes of stepped segments,
+// which never go through the greedy search. Curves without stepped keys keep what the plain
+// greedy search keeps.
+// outKeys receives the sorted positions of the kept samples.
+void reduceSamples(const CurveSamples &samples, const double deviation, std::vector<int> &outKeys);
+void reduceSamples(const CurveSamples &samples, const double deviation, std::vector<int> &outKeys, ReduceScratch &scratch);
+
+// Error of the greedy reduction for every number of kept samples.
+// errors[i] is the biggest deviation left once minKeys + i samples are kept, order[i] is the
+// sample the search keeps next. Every coarser reduction is a prefix of order.
+class ReductionTradeOff
+{
+public:
+    // samples kept by the pre-pass, no tolerance keeps fewer
+    unsigned int minKeys;
+    std::vector<int> seedKeys;
+    std::vector<double> errors;
+    std::vector<int> order;
+
+    // number of samples reduceSamples keeps with the given tolerance, error receives the deviation left
+    unsigned int keysForTolerance(const double tolerance, double &error) const;
+    // tightest tolerance keeping at most maxKeys samples, or as close as the pre-pass allows
+    double toleranceForKeys(const unsigned int maxKeys) const;
+    // sorted positions of the samples reduceSamples keeps with the given tolerance
+    void keysForLevel(const double tolerance, std::vector<int> &outKeys) const;
+};
+
+// Runs the greedy search until no sample deviates more than stopDeviation, 0 by default,
+// recording the error at each step. The trade-off is only valid for tolerances from stopDeviation up.
+void reductionTradeOff(const CurveSamples &samples, ReductionTradeOff &tradeOff);
+void reductionTradeOff(const CurveSamples &samples, ReductionTradeOff &tradeOff, ReduceScratch &scratch, const double stopDeviation);
+
+// Tightest tolerance keeping at most maxKeys samples across all the given curves
+double groupTolerance(const std::vector<ReductionTradeOff> &tradeOffs, const unsigned int maxKeys);
+
+// Online reduction for samples arriving one at a time in increasing time, i.e. while recording.
+// Every dropped sample stays within the deviation of the line through the keys around it, as in
+// reduceSamples, but keys are decided looking forward only: a sample becomes a key as soon as no
+// line from the last key can go through the next sample while keeping all the samples in between
+// within the deviation. The allowed directions from the last key are kept as a cone of angles,
+// so each sample costs O(1) and only the last key and the last sample are remembered.
+class StreamReducer
+{
+public:
+    StreamReducer(const double deviation = 0.5);
+
+    void reset(const double deviation);
+
+    // returns true when a key is final, its time and value are written to keyTime and keyValue.
+    // Samples not later than the previous one are ignored.
+    bool addSample(const double time, const double value, double &keyTime, double &keyValue);
+    // ends the curve, the last sample is always a key. Returns false if it is already one.
+    bool finish(double &keyTime, double &keyValue);
+
+    unsigned int numSamples, numKeys;
+
+private:
+    double deviation;
+    double keyTime, keyValue;
+    double lastTime, lastValue;
+    bool hasKey, hasLast;
+    double lowAngle, highAngle;
+
+    void resetCone();
+    bool isInCone(const double angle) const;
+    void narrowCone(const double time, const double value);
+};
+
+#endif
@@ -0,0 +1,85 @@
+//
+//  keyReducerNode.h
+//  keyReducer
+//
+//
+
+#ifndef keyReducer_keyReducerNode_h
+#define keyReducer_keyReducerNode_h
+
+#include <maya/MPxNode.h>
+#include <maya/MTypeId.h>
+#include <maya/MDataBlock.h>
+#include <maya/MPlug.h>
+#include <maya/MObjectArray.h>
+#include <maya/MMessage.h>
+#include <maya/MTime.h>
+#include <maya/MFnAnimCurve.h>
+#include <maya/MSpinLock.h>
+
+#include <vector>
+
+#include "keyReducerCore.h"
+
+/*
+ Outputs the value of the reduced version of the connected animation curve at the given time.
+ The kept keys are evaluated with the tangents the command would give them, including the hold
+ keys fixCurve adds back. The keys are read again only when the curve is edited, the reduction
+ only runs again when they or the tolerance change.
+ */
+class KeyReducerNode : public MPxNode
+{
+public:
+    KeyReducerNode();
+    ~KeyReducerNode();
+
+    void postConstructor();
+    MStatus compute(const MPlug &plug, MDataBlock &data);
+
+#if defined(MAYA2018)
+    // the Evaluation Manager can't see that the edits of the curve dirty the node through the callback
+    SchedulingType schedulingType() const { return kUntrusted; }
+#endif
+
+    static void* creator();
+    static MStatus initialize();
+
+    static MTypeId id;
+
+    static MObject inputCurve;
+    static MObject tolerance;
+    static MObject time;
+    static MObject curveEdits;
+    static MObject output;
+
+private:
+    // the message connection is not dirtied by key edits, the callback bumps curveEdits instead
+    static void curveEdited(MObjectArray &editedCurves, void *clientData);
+
+    MObject connectedCurve();
+    void readCurve(const MObject &curve);
+    void reduceCurve(const double &toleranceValue);
+    void addHoldKeys();
+    double evaluate(const double &t) const;
+    double evaluateSegment(const unsigned int previous, const double &t) const;
+
+    MCallbackId editedCallback;
+    // the callback runs on the main thread, compute may not, sourceCurve and curveChanged are shared
+    MSpinLock curveLock;
+    MObject sourceCurve;
+    bool curveChanged;
+    MTime::Unit samplesUnit;
+    CurveSamples samples;
+
+    std::vector<int> keptKeys;
+    bool hasReduction;
+    double reductionTolerance;
+
+    // the keys the command would write, their times in ui units and the tangents in seconds
+    bool weighted;
+    double secondsPerUnit;
+    std::vector<KeyData> reducedKeys;
+    std::vector<double> reducedTimes;
+};
+
+#endif
@@ -0,0 +1,71 @@
+//
+//  reducePipeline.h
+//  keyReducer
+//
+//
+
+#ifndef keyReducer_reducePipeline_h
+#define keyReducer_reducePipeline_h
+
+#include <maya/MThreadAsync.h>
+
+#include <pthread.h>
+
+#include <deque>
+#include <vector>
+
+#include "keyReducerCore.h"
+
+// Keys of a curve, or of a window of it, snapshotted on the main thread and reduced by a worker.
+// done is for the caller, once the task is popped back from the queue.
+class ReduceTask
+{
+public:
+    unsigned int first, last;
+    double deviation;
+    bool cached, done;
+    CurveSamples samples;
+    std::vector<int> keptKeys;
+};
+
+/*
+ Tasks reduced on the MThreadAsync pool while the main thread keeps reading and writing the curves.
+ Every worker started by push pulls the oldest queued task until the queue is empty, so a long
+ curve only keeps one worker busy while the others move on. The main thread can pull tasks too
+ when it has nothing else to do, or sleep until a worker is done with one. The workers never touch the DG.
+ The pool has to be initialized with MThreadAsync::init, the plugin keeps it for its whole life.
+ */
+class ReduceQueue
+{
+public:
+    // the reducer threads are given one scratch each, until the queue is empty
+    ReduceQueue(std::vector<ReduceScratch> &scratches);
+
+    // waits for the workers still running
+    ~ReduceQueue();
+
+    void push(ReduceTask *task);
+
+    // the calling thread reduces the oldest queued task, when none is queued it waits until
+    // a task being reduced is done
+    void reduceOrWait(ReduceScratch &scratch);
+
+    // pops a reduced task, false if none is done yet
+    bool popDone(ReduceTask *&task);
+
+private:
+    static MThreadRetVal work(void *data);
+    static void workDone(void *data);
+
+    void reduce(ReduceTask *task, ReduceScratch &scratch);
+
+    // the workers signal changed when a task is done and when they return
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    std::deque<ReduceTask *> pending, done;
+    std::vector<ReduceScratch *> freeScratches;
+    unsigned int reducing;
+    unsigned int numWorkers;
+};
+
+#endif
@@ -0,0 +1,79 @@
+//
+//  reductionCache.h
+//  keyReducer
+//
+//
+
+#ifndef keyReducer_reductionCache_h
+#define keyReducer_reductionCache_h
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MGlobal.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "keyReducerCore.h"
+
+typedef unsigned long long CurveHash;
+
+// Hash of the samples and of the deviation they are reduced with
+CurveHash hashSamples(const CurveSamples &samples, const double deviation);
+
+class CachedReduction
+{
+public:
+    CurveHash hash;
+    unsigned int numSamples;
+    std::vector<int> keptKeys;
+};
+
+/*
+ Least recently used map from the hash of the reduced samples to the kept keys.
+ When a file is set the entries are loaded from it and can be saved back to it.
+ */
+class ReductionCache
+{
+public:
+    static bool find(const CurveSamples &samples, const double deviation, std::vector<int> &keptKeys);
+    static void insert(const CurveSamples &samples, const double deviation, const std::vector<int> &keptKeys);
+
+    static void clear();
+    static void resetStats();
+    static void setCapacity(const unsigned int capacity);
+
+    static bool setFile(const MString &path);
+    static bool save();
+
+    static unsigned int capacity;
+    static unsigned int hits;
+    static unsigned int misses;
+    static MString filePath;
+
+    static std::list<CachedReduction> entries;
+
+private:
+    static void evict();
+
+    static std::map<CurveHash, std::list<CachedReduction>::iterator> lookup;
+};
+
+class ReductionCacheCmd: public MPxCommand
+{
+public:
+    ReductionCacheCmd();
+    ~ReductionCacheCmd(){}
+
+    MStatus doIt(const MArgList&);
+    bool isUndoable() const;
+
+    static MSyntax syntaxCreator();
+
+    static void* creator();
+};
+
+#endif
@@ -0,0 +1,92 @@
+//
+//  keyTransfer.cpp
+//  keyReducer
+//
+//
+
+// Times the transfer of the kept keys and their tangents headless, and counts the Maya API calls
+// it makes per key. copyKeys is the transfer alone, applyReducedKeys adds fixCurve and the copy
+// back into the source curve.
+
+#include <math.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "mockMaya.h"
+#include "keyReducerCmd.h"
+
+static double now()
+{
+    timeval time;
+    gettimeofday(&time, NULL);
+    return time.tv_sec + time.tv_usec * 1.0e-6;
+}
+
+// a smooth curve with a few holds and broken tangents, every fourth key is kept
+static MObject buildCurve(const char *name, const int numKeys, MIntArray &keptKeys)
+{
+    MFnAnimCurve fnCurve(MockMaya::addAnimCurve(name));
+    for (int i = 0; i < numKeys; ++i)
+    {
+        double value = (i % 100) < 20 ? 1.0 : sin(i * 0.05) * 10.0;
+        MFnAnimCurve::TangentType tangent = (i % 300) == 0 ? MFnAnimCurve::kTangentStep : MFnAnimCurve::kTangentSmooth;
+        fnCurve.addKey(MTime((double)i), value, tangent, tangent);
+        if (i % 7 == 0)
+        {
+            fnCurve.setTangentsLocked(i, false);
+            fnCurve.setTangent(i, 1.0f, 0.5f, true, NULL, false);
+        }
+    }
+
+    keptKeys.clear();
+    for (int i = 0; i < numKeys; i += 4)
+        keptKeys.append(i);
+    if (keptKeys[keptKeys.length() - 1] != numKeys - 1)
+        keptKeys.append(numKeys - 1);
+
+    return fnCurve.object();
+}
+
+static void report(const char *name, const int numKeys, const unsigned int numKept, const int runs, const double seconds)
+{
+    printf("%-18s %7d keys %6u kept  %8.3f ms/run  %7.2f calls/kept key\n",
+           name, numKeys, numKept, seconds * 1000.0 / runs, (double)MockMaya::totalCalls() / runs / numKept);
+}
+
+int main()
+{
+    const int sizes[] = {1000, 10000};
+    ReduceScratch scratch;
+
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        const int numKeys = sizes[s];
+        const int runs = numKeys > 1000 ? 3 : 10;
+
+        MockMaya::reset();
+        MIntArray keptKeys;
+        MFnAnimCurve fnSource(buildCurve("source.tx", numKeys, keptKeys));
+
+        MockMaya::resetCalls();
+        double start = now();
+        for (int r = 0; r < runs; ++r)
+        {
+            MFnAnimCurve fnDest;
+            fnDest.create(MFnAnimCurve::kAnimCurveTL);
+            copyKeys(keptKeys, fnSource, fnDest, NULL, scratch);
+        }
+        report("copyKeys", numKeys, keptKeys.length(), runs, now() - start);
+
+        MockMaya::resetCalls();
+        start = now();
+        for (int r = 0; r < runs; ++r)
+        {
+            MAnimCurveChange change;
+            applyReducedKeys(fnSource, keptKeys, &change, scratch);
+            change.undoIt();
+        }
+        report("applyReducedKeys", numKeys, keptKeys.length(), runs, now() - start);
+    }
+
+    return 0;
+}
@@ -0,0 +1 @@
+#include "../mockMaya.h"
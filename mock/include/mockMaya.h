@@ -0,0 +1,907 @@
+//
+//  mockMaya.h
+//  keyReducer
+//
+//
+
+#ifndef keyReducer_mockMaya_h
+#define keyReducer_mockMaya_h
+
+/*
+ Stand-in for the subset of the Maya API used by the tcKeyReducer, tcStoreKeys and tcRestoreKeys
+ commands, so they can be built and run outside of Maya. Curves live in an in-memory scene created
+ through MockMaya, every call to the animation API is counted.
+ Animation curves are evaluated linearly between keys, or held after a stepped key.
+ */
+
+// the Maya headers bring these in for the plugin sources
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#define MAYA_API_VERSION 201400
+
+class MObject;
+class MPlug;
+class MString;
+class MSyntax;
+class MArgList;
+class MPxCommand;
+class MDGModifier;
+class MAnimCurveChange;
+class MockNode;
+class MockKeyframeDelta;
+
+/*
+ CALL COUNTERS
+ */
+
+enum MockCall
+{
+    kMockCurveCreate = 0,
+    kMockCurveType,
+    kMockCurveNumKeys,
+    kMockCurveTime,
+    kMockCurveValue,
+    kMockCurveEvaluate,
+    kMockCurveFind,
+    kMockCurveFindClosest,
+    kMockCurveAddKey,
+    kMockCurveAddKeyframe,
+    kMockCurveRemove,
+    kMockCurveInTangentType,
+    kMockCurveOutTangentType,
+    kMockCurveGetTangent,
+    kMockCurveSetTangent,
+    kMockCurveTangentsLocked,
+    kMockCurveWeightsLocked,
+    kMockCurveSetTangentsLocked,
+    kMockCurveSetWeightsLocked,
+    kMockCurveIsWeighted,
+    kMockCurveSetIsWeighted,
+    kMockCurveChangeUndo,
+    kMockCurveChangeRedo,
+    kMockTimeAs,
+    kMockTimeUiUnit,
+    kMockPlugNode,
+    kMockPlugPartialName,
+    kMockSelectionGetPlug,
+    kMockKeyframeDelta,
+    kMockNumCalls
+};
+
+/*
+ STATUS AND ARRAYS
+ */
+
+class MStatus
+{
+public:
+    enum MStatusCode
+    {
+        kSuccess = 0,
+        kFailure,
+        kInsufficientMemory,
+        kInvalidParameter,
+        kLicenseFailure,
+        kUnknownParameter,
+        kNotImplemented,
+        kNotFound,
+        kEndOfFile
+    };
+
+    MStatus(): code(kSuccess) {}
+    MStatus(MStatusCode c): code(c) {}
+
+    operator bool() const { return code == kSuccess; }
+    bool operator==(const MStatus &other) const { return code == other.code; }
+    bool operator!=(const MStatus &other) const { return code != other.code; }
+    bool operator==(MStatusCode c) const { return code == c; }
+    bool operator!=(MStatusCode c) const { return code != c; }
+    MStatusCode statusCode() const { return code; }
+    void perror(const char *message) const;
+
+private:
+    MStatusCode code;
+};
+
+typedef MStatus MS;
+
+class MString
+{
+public:
+    MString() {}
+    MString(const char *chars): str(chars ? chars : "") {}
+    MString(const std::string &s): str(s) {}
+
+    const char *asChar() const { return str.c_str(); }
+    unsigned int length() const { return (unsigned int)str.length(); }
+    unsigned int numChars() const { return (unsigned int)str.length(); }
+
+    MString &operator+=(const MString &other) { str += other.str; return *this; }
+    MString &operator+=(const char *other) { str += other; return *this; }
+    MString &operator+=(double value);
+    MString &operator+=(int value);
+    MString &operator+=(unsigned int value);
+    MString operator+(const MString &other) const { return MString(str + other.str); }
+    MString operator+(const char *other) const { return MString(str + other); }
+    bool operator==(const MString &other) const { return str == other.str; }
+    bool operator!=(const MString &other) const { return str != other.str; }
+    bool operator<(const MString &other) const { return str < other.str; }
+
+    bool isDouble() const;
+    double asDouble() const;
+    bool isInt() const;
+    int asInt() const;
+    void set(double value);
+    void set(double value, int precision);
+    int indexW(const MString &other) const;
+    int rindexW(char c) const;
+    MString substringW(int start, int end) const;
+
+    const std::string &std() const { return str; }
+
+private:
+    std::string str;
+};
+
+MString operator+(const char *chars, const MString &other);
+
+template <class T>
+class MockArray
+{
+public:
+    MockArray() {}
+    MockArray(unsigned int length, const T &value): items(length, value) {}
+
+    unsigned int length() const { return (unsigned int)items.size(); }
+    const T &operator[](unsigned int index) const { return items[index]; }
+    T &operator[](unsigned int index) { return items[index]; }
+    MStatus append(const T &value) { items.push_back(value); return MS::kSuccess; }
+    MStatus insert(const T &value, unsigned int index) { items.insert(items.begin() + index, value); return MS::kSuccess; }
+    MStatus remove(unsigned int index) { items.erase(items.begin() + index); return MS::kSuccess; }
+    MStatus setLength(unsigned int length) { items.resize(length); return MS::kSuccess; }
+    MStatus setSizeIncrement(unsigned int) { return MS::kSuccess; }
+    MStatus clear() { items.clear(); return MS::kSuccess; }
+
+private:
+    std::vector<T> items;
+};
+
+class MIntArray : public MockArray<int>
+{
+public:
+    MIntArray() {}
+    MIntArray(unsigned int length, int value = 0): MockArray<int>(length, value) {}
+};
+
+class MDoubleArray : public MockArray<double>
+{
+public:
+    MDoubleArray() {}
+    MDoubleArray(unsigned int length, double value = 0.0): MockArray<double>(length, value) {}
+};
+
+class MStringArray : public MockArray<MString>
+{
+public:
+    MStringArray() {}
+};
+
+/*
+ MATH AND TIME
+ */
+
+class MVector
+{
+public:
+    MVector(double xx = 0.0, double yy = 0.0, double zz = 0.0): x(xx), y(yy), z(zz) {}
+
+    MVector operator+(const MVector &other) const { return MVector(x + other.x, y + other.y, z + other.z); }
+    MVector operator-(const MVector &other) const { return MVector(x - other.x, y - other.y, z - other.z); }
+    MVector operator*(double scale) const { return MVector(x * scale, y * scale, z * scale); }
+    double operator*(const MVector &other) const { return x * other.x + y * other.y + z * other.z; }
+    double length() const;
+    MStatus normalize();
+
+    double x, y, z;
+};
+
+MVector operator*(double scale, const MVector &vector);
+
+class MTime
+{
+public:
+    enum Unit
+    {
+        kInvalid = 0,
+        kHours,
+        kMinutes,
+        kSeconds,
+        kMilliseconds,
+        kGames,
+        kFilm,
+        kPALFrame,
+        kNTSCFrame,
+        kShowScan,
+        kPALField,
+        kNTSCField,
+        k100FPS,
+        k120FPS,
+        kLast
+    };
+
+    MTime(): seconds(0.0), valueUnit(uiUnit()) {}
+    MTime(double value, Unit unit = uiUnit());
+
+    double as(Unit unit) const;
+    double value() const;
+    Unit unit() const { return valueUnit; }
+
+    static Unit uiUnit();
+    static MStatus setUIUnit(Unit unit);
+
+    MTime operator+(const MTime &other) const;
+    MTime operator-(const MTime &other) const;
+    MTime operator+(double value) const;
+    MTime operator-(double value) const;
+    bool operator==(const MTime &other) const;
+    bool operator!=(const MTime &other) const { return !(*this == other); }
+    bool operator<(const MTime &other) const;
+    bool operator>(const MTime &other) const { return other < *this; }
+    bool operator<=(const MTime &other) const { return !(other < *this); }
+    bool operator>=(const MTime &other) const { return !(*this < other); }
+
+    double asSeconds() const { return seconds; }
+
+    // a time in the UI unit, without counting the uiUnit call
+    static MTime inUiUnit(double seconds);
+
+private:
+    static double unitsPerSecond(Unit unit);
+
+    double seconds;
+    Unit valueUnit;
+    static Unit currentUiUnit;
+};
+
+class MTimeArray : public MockArray<MTime>
+{
+public:
+    MTimeArray() {}
+};
+
+/*
+ OBJECTS AND PLUGS
+ */
+
+// only the types the plugin tests for
+namespace MFn
+{
+    enum Type
+    {
+        kInvalid = 0,
+        kAnimCurve,
+        kKeyframeDelta,
+        kKeyframeDeltaAddRemove,
+        kKeyframeDeltaMove,
+        kKeyframeDeltaTangent
+    };
+}
+
+class MObject
+{
+public:
+    MObject(): mockNode(NULL), mockDelta(NULL) {}
+    explicit MObject(MockNode *n): mockNode(n), mockDelta(NULL) {}
+    explicit MObject(MockKeyframeDelta *d): mockNode(NULL), mockDelta(d) {}
+
+    bool isNull() const { return mockNode == NULL && mockDelta == NULL; }
+    bool hasFn(MFn::Type type) const;
+    bool operator==(const MObject &other) const { return mockNode == other.mockNode && mockDelta == other.mockDelta; }
+    bool operator!=(const MObject &other) const { return !(*this == other); }
+
+    static MObject kNullObj;
+
+    MockNode *mockNode;
+    MockKeyframeDelta *mockDelta;
+};
+
+class MObjectArray : public MockArray<MObject>
+{
+public:
+    MObjectArray() {}
+};
+
+// valid while its node is in the scene and not deleted, MockMaya::reset removes every node
+class MObjectHandle
+{
+public:
+    MObjectHandle(): serial(0) {}
+    MObjectHandle(const MObject &object);
+
+    MObject object() const { return isValid() ? mockObject : MObject(); }
+    bool isValid() const;
+    bool isAlive() const { return isValid(); }
+    unsigned int hashCode() const { return serial; }
+
+private:
+    MObject mockObject;
+    unsigned int serial;
+};
+
+class MPlug
+{
+public:
+    MPlug(): mockNode(NULL) {}
+    MPlug(MockNode *n, const std::string &a): mockNode(n), attribute(a) {}
+
+    MObject node(MStatus *ReturnStatus = NULL) const;
+    MString name(MStatus *ReturnStatus = NULL) const;
+    MString partialName(bool includeNodeName = false, bool includeNonMandatoryIndices = false, bool includeInstancedIndices = false,
+                        bool useAlias = false, bool useFullAttributePath = false, bool useLongNames = false, MStatus *ReturnStatus = NULL) const;
+    bool isNull(MStatus *ReturnStatus = NULL) const { if (ReturnStatus) *ReturnStatus = MS::kSuccess; return mockNode == NULL; }
+    double asDouble(MStatus *ReturnStatus = NULL) const;
+    MStatus setDouble(double value);
+    bool operator==(const MPlug &other) const { return mockNode == other.mockNode && attribute == other.attribute; }
+
+    MockNode *mockNode;
+    std::string attribute;
+};
+
+class MPlugArray : public MockArray<MPlug>
+{
+public:
+    MPlugArray() {}
+};
+
+class MSelectionList
+{
+public:
+    MSelectionList() {}
+
+    MStatus add(const MString &matchString, bool searchChildNamespacesToo = false);
+    MStatus getPlug(unsigned int index, MPlug &plug) const;
+    MStatus getDependNode(unsigned int index, MObject &object) const;
+    unsigned int length(MStatus *ReturnStatus = NULL) const { if (ReturnStatus) *ReturnStatus = MS::kSuccess; return (unsigned int)plugs.size(); }
+    MStatus clear() { plugs.clear(); return MS::kSuccess; }
+
+private:
+    std::vector<MPlug> plugs;
+};
+
+class MDagPath
+{
+public:
+    MDagPath() {}
+
+    static MStatus getAPathTo(const MObject &object, MDagPath &path);
+    MString fullPathName(MStatus *ReturnStatus = NULL) const { if (ReturnStatus) *ReturnStatus = MS::kSuccess; return path; }
+
+private:
+    MString path;
+};
+
+class MDGModifier
+{
+public:
+    MDGModifier() {}
+    virtual ~MDGModifier() {}
+
+    MStatus doIt();
+    MStatus undoIt();
+    MStatus renameNode(const MObject &node, const MString &newName);
+
+    std::vector<MockNode *> createdNodes;
+};
+
+/*
+ ANIMATION
+ */
+
+class MockKey
+{
+public:
+    double time;
+    double value;
+    int inTangentType;
+    int outTangentType;
+    float inTangentX, inTangentY, outTangentX, outTangentY;
+    bool tangentsLocked;
+    bool weightsLocked;
+};
+
+class MockCurveState
+{
+public:
+    std::vector<MockKey> keys;
+    bool isWeighted;
+};
+
+class MockNode
+{
+public:
+    MockNode(): isAnimCurve(false), animCurveType(0), deleted(false), serial(0) {}
+
+    std::string name;
+    bool isAnimCurve;
+    int animCurveType;
+    bool deleted;
+    // never reused, a handle to a removed node can't see the node created at its address
+    unsigned int serial;
+    MockCurveState curve;
+
+    std::map<std::string, double> values;
+    std::map<std::string, MockNode *> inputCurves;
+};
+
+class MFnDependencyNode
+{
+public:
+    MFnDependencyNode(): mockNode(NULL) {}
+    MFnDependencyNode(const MObject &object, MStatus *ReturnStatus = NULL);
+    virtual ~MFnDependencyNode() {}
+
+    MStatus setObject(const MObject &object) { mockNode = object.mockNode; return MS::kSuccess; }
+    MObject object(MStatus *ReturnStatus = NULL) const { if (ReturnStatus) *ReturnStatus = MS::kSuccess; return MObject(mockNode); }
+    MString name(MStatus *ReturnStatus = NULL) const;
+    MString setName(const MString &name, bool createNamespace = false, MStatus *ReturnStatus = NULL);
+
+protected:
+    MockNode *mockNode;
+};
+
+class MFnAnimCurve : public MFnDependencyNode
+{
+public:
+    enum AnimCurveType
+    {
+        kAnimCurveTA = 0,
+        kAnimCurveTL,
+        kAnimCurveTT,
+        kAnimCurveTU,
+        kAnimCurveUA,
+        kAnimCurveUL,
+        kAnimCurveUT,
+        kAnimCurveUU,
+        kAnimCurveUnknown
+    };
+
+    enum TangentType
+    {
+        kTangentGlobal = 0,
+        kTangentFixed,
+        kTangentLinear,
+        kTangentFlat,
+        kTangentSmooth,
+        kTangentStep,
+        kTangentSlow,
+        kTangentFast,
+        kTangentClamped,
+        kTangentPlateau,
+        kTangentStepNext,
+        kTangentAuto
+    };
+
+    typedef float TangentValue;
+
+    MFnAnimCurve() {}
+    MFnAnimCurve(const MObject &object, MStatus *ReturnStatus = NULL);
+    MFnAnimCurve(const MPlug &plug, MStatus *ReturnStatus = NULL);
+
+    MObject create(AnimCurveType animCurveType, MDGModifier *modifier = NULL, MStatus *ReturnStatus = NULL);
+    MObject create(const MPlug &plug, MDGModifier *modifier = NULL, MStatus *ReturnStatus = NULL);
+    AnimCurveType animCurveType(MStatus *ReturnStatus = NULL) const;
+    // the mock has no attribute types, every plug gets a linear curve
+    AnimCurveType timedAnimCurveTypeForPlug(MPlug &plug, MStatus *ReturnStatus = NULL) const;
+
+    unsigned int numKeys(MStatus *ReturnStatus = NULL) const;
+    unsigned int numKeyframes(MStatus *ReturnStatus = NULL) const { return numKeys(ReturnStatus); }
+    MTime time(unsigned int index, MStatus *ReturnStatus = NULL) const;
+    double value(unsigned int index, MStatus *ReturnStatus = NULL) const;
+    double evaluate(const MTime &atTime, MStatus *ReturnStatus = NULL) const;
+    bool find(const MTime &atTime, unsigned int &index, MStatus *ReturnStatus = NULL) const;
+    unsigned int findClosest(const MTime &atTime, MStatus *ReturnStatus = NULL) const;
+
+    unsigned int addKey(const MTime &atTime, double value, TangentType tangentInType = kTangentGlobal, TangentType tangentOutType = kTangentGlobal,
+                        MAnimCurveChange *change = NULL, MStatus *ReturnStatus = NULL);
+    MStatus addKeyframe(const MTime &atTime, double value, MAnimCurveChange *change = NULL);
+    MStatus remove(unsigned int index, MAnimCurveChange *change = NULL);
+
+    TangentType inTangentType(unsigned int index, MStatus *ReturnStatus = NULL) const;
+    TangentType outTangentType(unsigned int index, MStatus *ReturnStatus = NULL) const;
+    MStatus getTangent(unsigned int index, float &x, float &y, bool inTangent) const;
+    MStatus setTangent(unsigned int index, float x, float y, bool inTangent, MAnimCurveChange *change = NULL, bool convertUnits = true);
+
+    bool tangentsLocked(unsigned int index, MStatus *ReturnStatus = NULL) const;
+    bool weightsLocked(unsigned int index, MStatus *ReturnStatus = NULL) const;
+    MStatus setTangentsLocked(unsigned int index, bool locked, MAnimCurveChange *change = NULL);
+    MStatus setWeightsLocked(unsigned int index, bool locked, MAnimCurveChange *change = NULL);
+
+    bool isWeighted(MStatus *ReturnStatus = NULL) const;
+    MStatus setIsWeighted(bool isWeighted, MAnimCurveChange *change = NULL);
+
+private:
+    bool isValidKey(unsigned int index, MStatus *ReturnStatus) const;
+    unsigned int insertKey(const MTime &atTime, double value, TangentType tangentInType, TangentType tangentOutType,
+                           MAnimCurveChange *change, MStatus *ReturnStatus);
+};
+
+class MAnimCurveChange
+{
+public:
+    MAnimCurveChange() {}
+    virtual ~MAnimCurveChange() {}
+
+    MStatus undoIt();
+    MStatus redoIt();
+
+    // saves the state of the curve the first time this change edits it
+    void record(MockNode *node);
+
+private:
+    std::vector<MockNode *> nodes;
+    std::vector<MockCurveState> before;
+    std::vector<MockCurveState> after;
+};
+
+/*
+ MESSAGES
+ */
+
+typedef unsigned long MCallbackId;
+typedef void (*MObjectArrayFunction)(MObjectArray &objects, void *clientData);
+
+class MCallbackIdArray : public MockArray<MCallbackId>
+{
+public:
+    MCallbackIdArray() {}
+};
+
+// A keyframe edit as Maya reports it, the curve edits record one when a callback is registered
+class MockKeyframeDelta
+{
+public:
+    MFn::Type type;
+    MockNode *curve;
+    unsigned int keyIndex;
+    double time, previousTime;
+    // a MFnKeyframeDeltaAddRemove::DeltaType for the added and removed keys
+    int addRemoveType;
+};
+
+class MFnKeyframeDelta
+{
+public:
+    MFnKeyframeDelta(const MObject &object, MStatus *ReturnStatus = NULL);
+    virtual ~MFnKeyframeDelta() {}
+
+    MObject paramCurve(MStatus *ReturnStatus = NULL) const;
+    unsigned int keyIndex(MStatus *ReturnStatus = NULL) const;
+
+protected:
+    MockKeyframeDelta *mockDelta;
+};
+
+class MFnKeyframeDeltaAddRemove : public MFnKeyframeDelta
+{
+public:
+    enum DeltaType
+    {
+        kAdded = 0,
+        kRemoved,
+        kReplaced
+    };
+
+    MFnKeyframeDeltaAddRemove(const MObject &object, MStatus *ReturnStatus = NULL): MFnKeyframeDelta(object, ReturnStatus) {}
+
+    DeltaType deltaType(MStatus *ReturnStatus = NULL) const;
+    MTime time(MStatus *ReturnStatus = NULL) const;
+};
+
+class MFnKeyframeDeltaMove : public MFnKeyframeDelta
+{
+public:
+    MFnKeyframeDeltaMove(const MObject &object, MStatus *ReturnStatus = NULL): MFnKeyframeDelta(object, ReturnStatus) {}
+
+    MTime currentTime(MStatus *ReturnStatus = NULL) const;
+    MTime previousTime(MStatus *ReturnStatus = NULL) const;
+};
+
+// The callbacks of every message class share one id sequence, a removed callback is never called again
+class MMessage
+{
+public:
+    typedef void (*MBasicFunction)(void *clientData);
+
+    static MStatus removeCallback(MCallbackId id);
+    static MStatus removeCallbacks(MCallbackIdArray &ids);
+
+protected:
+    static MCallbackId nextId;
+};
+
+// the deltas are held until flushAnimKeyframeEditedCallbacks, undo and redo report none
+class MAnimMessage : public MMessage
+{
+public:
+    static MCallbackId addAnimKeyframeEditedCallback(MObjectArrayFunction func, void *clientData = NULL, MStatus *ReturnStatus = NULL);
+    static void flushAnimKeyframeEditedCallbacks();
+
+    // mock only, called by the curve edits
+    static void recordDelta(const MFn::Type type, MockNode *curve, const unsigned int keyIndex, const double time, const double previousTime,
+                            const int addRemoveType = 0);
+    static void clearDeltas();
+
+private:
+    friend class MMessage;
+    struct Callback
+    {
+        MCallbackId id;
+        MObjectArrayFunction func;
+        void *clientData;
+    };
+    static std::vector<Callback> callbacks;
+    static std::vector<MockKeyframeDelta *> deltas;
+};
+
+// MockMaya::reset is a new scene, it sends kAfterNew
+class MSceneMessage : public MMessage
+{
+public:
+    enum Message
+    {
+        kAfterNew,
+        kAfterOpen,
+        kBeforeSave,
+        kBeforeExport
+    };
+
+    static MCallbackId addCallback(Message message, MMessage::MBasicFunction func, void *clientData = NULL, MStatus *ReturnStatus = NULL);
+
+    // mock only
+    static void notify(Message message);
+
+private:
+    friend class MMessage;
+    struct Callback
+    {
+        MCallbackId id;
+        Message message;
+        MMessage::MBasicFunction func;
+        void *clientData;
+    };
+    static std::vector<Callback> callbacks;
+};
+
+class MAnimControl
+{
+public:
+    static MTime currentTime();
+    static MStatus setCurrentTime(const MTime &time);
+    static MTime minTime();
+    static MTime maxTime();
+};
+
+/*
+ COMMANDS
+ */
+
+class MArgList
+{
+public:
+    MArgList() {}
+
+    unsigned int length(MStatus *ReturnStatus = NULL) const { if (ReturnStatus) *ReturnStatus = MS::kSuccess; return (unsigned int)args.size(); }
+    MString asString(unsigned int index, MStatus *ReturnStatus = NULL) const;
+    double asDouble(unsigned int index, MStatus *ReturnStatus = NULL) const;
+    int asInt(unsigned int index, MStatus *ReturnStatus = NULL) const;
+
+    MArgList &addArg(const MString &arg) { args.push_back(arg); return *this; }
+    MArgList &addArg(double arg);
+    MArgList &addArg(int arg);
+
+    // flags and their arguments, kept apart from the positional arguments the commands iterate
+    std::vector<MString> flagTokens;
+
+private:
+    std::vector<MString> args;
+};
+
+class MSyntax
+{
+public:
+    enum MArgType
+    {
+        kInvalidArgType = 0,
+        kNoArg,
+        kBoolean,
+        kLong,
+        kDouble,
+        kString,
+        kUnsigned,
+        kDistance,
+        kAngle,
+        kTime,
+        kSelectionItem,
+        kLastArgType
+    };
+
+    MSyntax() {}
+
+    MStatus addFlag(const char *shortName, const char *longName, MArgType argType1 = kNoArg, MArgType argType2 = kNoArg,
+                    MArgType argType3 = kNoArg, MArgType argType4 = kNoArg, MArgType argType5 = kNoArg, MArgType argType6 = kNoArg);
+    MStatus makeFlagMultiUse(const char *flagName);
+    MStatus enableQuery(bool supportsQuery = true) { return MS::kSuccess; }
+    MStatus enableEdit(bool supportsEdit = true) { return MS::kSuccess; }
+
+    // index of the flag matching the short or long name, -1 if not found
+    int findFlag(const std::string &flagName) const;
+    unsigned int numFlagArgs(int flag) const;
+
+private:
+    class Flag
+    {
+    public:
+        std::string shortName, longName;
+        std::vector<MArgType> argTypes;
+        bool multiUse;
+    };
+    std::vector<Flag> flags;
+};
+
+class MArgDatabase
+{
+public:
+    MArgDatabase(const MSyntax &syntax, const MArgList &args, MStatus *ReturnStatus = NULL);
+
+    bool isFlagSet(const char *flag, MStatus *ReturnStatus = NULL) const;
+    unsigned int numberOfFlagUses(const char *flag) const;
+    MStatus getFlagArgument(const char *flag, unsigned int index, bool &result) const;
+    MStatus getFlagArgument(const char *flag, unsigned int index, int &result) const;
+    MStatus getFlagArgument(const char *flag, unsigned int index, unsigned int &result) const;
+    MStatus getFlagArgument(const char *flag, unsigned int index, double &result) const;
+    MStatus getFlagArgument(const char *flag, unsigned int index, MString &result) const;
+    MStatus getFlagArgumentList(const char *flag, unsigned int use, MArgList &args) const;
+
+private:
+    const MString *flagArgument(const char *flag, unsigned int use, unsigned int index) const;
+
+    MSyntax syntax;
+    std::map<int, std::vector<std::vector<MString> > > uses;
+};
+
+class MPxCommand
+{
+public:
+    MPxCommand() {}
+    virtual ~MPxCommand() {}
+
+    virtual MStatus doIt(const MArgList &args) = 0;
+    virtual MStatus undoIt() { return MS::kFailure; }
+    virtual MStatus redoIt() { return MS::kFailure; }
+    virtual bool isUndoable() const { return false; }
+
+    MSyntax syntax(MStatus *ReturnStatus = NULL) const { if (ReturnStatus) *ReturnStatus = MS::kSuccess; return commandSyntax; }
+
+    static void clearResult();
+    static void setResult(bool result);
+    static void setResult(int result);
+    static void setResult(unsigned int result);
+    static void setResult(double result);
+    static void setResult(const MString &result);
+    static void setResult(const MIntArray &result);
+    static void setResult(const MDoubleArray &result);
+    static void setResult(const MStringArray &result);
+    static void appendToResult(int result);
+    static void appendToResult(double result);
+    static void appendToResult(const MString &result);
+
+private:
+    friend class MockMaya;
+    MSyntax commandSyntax;
+};
+
+class MGlobal
+{
+public:
+    static void displayInfo(const MString &message);
+    static void displayWarning(const MString &message);
+    static void displayError(const MString &message);
+    static MStatus executeCommand(const MString &command, bool displayEnabled = false, bool undoEnabled = false);
+};
+
+/*
+ THREADS
+ */
+
+typedef void *MThreadRetVal;
+typedef MThreadRetVal (*MThreadFunc)(void *);
+
+class MThreadRootTask
+{
+public:
+    std::vector<std::pair<MThreadFunc, void *> > tasks;
+};
+
+typedef void (*MThreadCallbackFunc)(void *, MThreadRootTask *);
+
+// tasks run one after the other on the calling thread, so the call counters stay exact
+class MThreadPool
+{
+public:
+    static MStatus init() { return MS::kSuccess; }
+    static void release() {}
+    static MStatus newParallelRegion(MThreadCallbackFunc func, void *data);
+    static MStatus createTask(MThreadFunc func, void *data, MThreadRootTask *root);
+    static MStatus executeAndJoin(MThreadRootTask *root);
+};
+
+// every task runs on a thread of its own, release waits for the ones still running
+class MThreadAsync
+{
+public:
+    static MStatus init() { return MS::kSuccess; }
+    static void release();
+    static MStatus createTask(MThreadFunc func, void *data, void (*doneFunc)(void *), void *doneData);
+};
+
+class MSpinLock
+{
+public:
+    MSpinLock();
+    ~MSpinLock();
+    void lock();
+    void unlock();
+    bool tryLock();
+
+private:
+    pthread_mutex_t mutex;
+};
+
+class MThreadUtils
+{
+public:
+    static int getNumThreads();
+};
+
+/*
+ SCENE AND COUNTERS
+ */
+
+class MockMaya
+{
+public:
+    // creates the node if needed and connects a new animation curve to its attribute
+    static MObject addAnimCurve(const MString &plugName, MFnAnimCurve::AnimCurveType type = MFnAnimCurve::kAnimCurveTL);
+    static MockNode *findNode(const std::string &name);
+    static MockNode *createNode(const std::string &name);
+    static bool hasNode(const MockNode *node, const unsigned int serial);
+    // removes every node of the scene
+    static void reset();
+
+    // parses args against the syntax the command was registered with and runs doIt
+    static MStatus runCommand(MPxCommand &command, MSyntax (*syntaxCreator)(), const MArgList &args);
+    static const std::vector<MString> &result() { return commandResult; }
+
+    static void count(const MockCall call) { counters[call]++; }
+    static unsigned long calls(const MockCall call) { return counters[call]; }
+    static unsigned long totalCalls();
+    static const char *callName(const MockCall call);
+    static void resetCalls();
+
+    static bool verbose;
+
+private:
+    friend class MPxCommand;
+    static std::vector<MockNode *> nodes;
+    static std::vector<MString> commandResult;
+    static unsigned long counters[kMockNumCalls];
+};
+
+#endif
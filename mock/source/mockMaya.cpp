@@ -0,0 +1,1522 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "mockMaya.h"
+
+/*
+ SCENE AND COUNTERS
+ */
+
+static const char *kMockCallNames[kMockNumCalls] =
+{
+    "MFnAnimCurve::create",
+    "MFnAnimCurve::animCurveType",
+    "MFnAnimCurve::numKeys",
+    "MFnAnimCurve::time",
+    "MFnAnimCurve::value",
+    "MFnAnimCurve::evaluate",
+    "MFnAnimCurve::find",
+    "MFnAnimCurve::findClosest",
+    "MFnAnimCurve::addKey",
+    "MFnAnimCurve::addKeyframe",
+    "MFnAnimCurve::remove",
+    "MFnAnimCurve::inTangentType",
+    "MFnAnimCurve::outTangentType",
+    "MFnAnimCurve::getTangent",
+    "MFnAnimCurve::setTangent",
+    "MFnAnimCurve::tangentsLocked",
+    "MFnAnimCurve::weightsLocked",
+    "MFnAnimCurve::setTangentsLocked",
+    "MFnAnimCurve::setWeightsLocked",
+    "MFnAnimCurve::isWeighted",
+    "MFnAnimCurve::setIsWeighted",
+    "MAnimCurveChange::undoIt",
+    "MAnimCurveChange::redoIt",
+    "MTime::as",
+    "MTime::uiUnit",
+    "MPlug::node",
+    "MPlug::partialName",
+    "MSelectionList::getPlug",
+    "MFnKeyframeDelta"
+};
+
+bool MockMaya::verbose = false;
+std::vector<MockNode *> MockMaya::nodes;
+std::vector<MString> MockMaya::commandResult;
+unsigned long MockMaya::counters[kMockNumCalls] = {0};
+
+MockNode *MockMaya::findNode(const std::string &name)
+{
+    std::string nodeName = name;
+    if (!nodeName.empty() && nodeName[0] == '|')
+        nodeName = nodeName.substr(1);
+
+    for (unsigned int i = 0; i < nodes.size(); ++i)
+        if (!nodes[i]->deleted && nodes[i]->name == nodeName)
+            return nodes[i];
+    return NULL;
+}
+
+MockNode *MockMaya::createNode(const std::string &name)
+{
+    static unsigned int numNodes = 0;
+    MockNode *node = new MockNode;
+    node->name = name;
+    node->serial = ++numNodes;
+    nodes.push_back(node);
+    return node;
+}
+
+bool MockMaya::hasNode(const MockNode *node, const unsigned int serial)
+{
+    for (unsigned int i = 0; i < nodes.size(); ++i)
+        if (nodes[i] == node)
+            return node->serial == serial && !node->deleted;
+    return false;
+}
+
+MObject MockMaya::addAnimCurve(const MString &plugName, MFnAnimCurve::AnimCurveType type)
+{
+    std::string name = plugName.std();
+    size_t dot = name.find('.');
+    if (dot == std::string::npos)
+        return MObject();
+
+    std::string nodeName = name.substr(0, dot);
+    std::string attribute = name.substr(dot + 1);
+
+    MockNode *node = findNode(nodeName);
+    if (!node)
+        node = createNode(nodeName);
+
+    MockNode *curve = createNode(nodeName + "_" + attribute);
+    curve->isAnimCurve = true;
+    curve->animCurveType = type;
+    curve->curve.isWeighted = false;
+    node->inputCurves[attribute] = curve;
+
+    return MObject(curve);
+}
+
+void MockMaya::reset()
+{
+    for (unsigned int i = 0; i < nodes.size(); ++i)
+        delete nodes[i];
+    nodes.clear();
+    commandResult.clear();
+    MAnimMessage::clearDeltas();
+    MSceneMessage::notify(MSceneMessage::kAfterNew);
+}
+
+MStatus MockMaya::runCommand(MPxCommand &command, MSyntax (*syntaxCreator)(), const MArgList &args)
+{
+    command.commandSyntax = syntaxCreator();
+    commandResult.clear();
+
+    MArgList commandArgs;
+    unsigned int i = 0;
+    while (i < args.length())
+    {
+        MString arg = args.asString(i);
+        int flag = arg.length() > 1 && arg.asChar()[0] == '-' && !arg.isDouble() ? command.commandSyntax.findFlag(arg.std()) : -1;
+        if (flag == -1)
+        {
+            commandArgs.addArg(arg);
+            ++i;
+            continue;
+        }
+
+        unsigned int numFlagArgs = command.commandSyntax.numFlagArgs(flag);
+        for (unsigned int j = 0; j <= numFlagArgs && i + j < args.length(); ++j)
+            commandArgs.flagTokens.push_back(args.asString(i + j));
+        i += numFlagArgs + 1;
+    }
+
+    return command.doIt(commandArgs);
+}
+
+unsigned long MockMaya::totalCalls()
+{
+    unsigned long total = 0;
+    for (int i = 0; i < kMockNumCalls; ++i)
+        total += counters[i];
+    return total;
+}
+
+const char *MockMaya::callName(const MockCall call)
+{
+    return kMockCallNames[call];
+}
+
+void MockMaya::resetCalls()
+{
+    for (int i = 0; i < kMockNumCalls; ++i)
+        counters[i] = 0;
+}
+
+/*
+ STATUS AND STRINGS
+ */
+
+void MStatus::perror(const char *message) const
+{
+    fprintf(stderr, "%s: status %d\n", message, (int)code);
+}
+
+MString &MString::operator+=(double value)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%g", value);
+    str += buffer;
+    return *this;
+}
+
+MString &MString::operator+=(int value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%d", value);
+    str += buffer;
+    return *this;
+}
+
+MString &MString::operator+=(unsigned int value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%u", value);
+    str += buffer;
+    return *this;
+}
+
+bool MString::isDouble() const
+{
+    if (str.empty())
+        return false;
+    char *end;
+    strtod(str.c_str(), &end);
+    return *end == '\0';
+}
+
+double MString::asDouble() const
+{
+    return atof(str.c_str());
+}
+
+bool MString::isInt() const
+{
+    if (str.empty())
+        return false;
+    char *end;
+    strtol(str.c_str(), &end, 10);
+    return *end == '\0';
+}
+
+int MString::asInt() const
+{
+    return atoi(str.c_str());
+}
+
+void MString::set(double value)
+{
+    str.clear();
+    *this += value;
+}
+
+void MString::set(double value, int precision)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+    str = buffer;
+}
+
+int MString::indexW(const MString &other) const
+{
+    size_t index = str.find(other.str);
+    return index == std::string::npos ? -1 : (int)index;
+}
+
+int MString::rindexW(char c) const
+{
+    size_t index = str.rfind(c);
+    return index == std::string::npos ? -1 : (int)index;
+}
+
+MString MString::substringW(int start, int end) const
+{
+    return MString(str.substr(start, end - start + 1));
+}
+
+MString operator+(const char *chars, const MString &other)
+{
+    return MString(chars) + other;
+}
+
+/*
+ MATH AND TIME
+ */
+
+double MVector::length() const
+{
+    return sqrt(x * x + y * y + z * z);
+}
+
+MStatus MVector::normalize()
+{
+    double len = length();
+    if (len > 0.0)
+    {
+        x /= len;
+        y /= len;
+        z /= len;
+    }
+    return MS::kSuccess;
+}
+
+MVector operator*(double scale, const MVector &vector)
+{
+    return vector * scale;
+}
+
+MTime::Unit MTime::currentUiUnit = MTime::kFilm;
+
+// times closer than this are the same time, Maya compares times in ticks
+static const double kTimeTolerance = 1.0e-7;
+
+double MTime::unitsPerSecond(Unit unit)
+{
+    switch (unit)
+    {
+        case kHours: return 1.0 / 3600.0;
+        case kMinutes: return 1.0 / 60.0;
+        case kSeconds: return 1.0;
+        case kMilliseconds: return 1000.0;
+        case kGames: return 15.0;
+        case kFilm: return 24.0;
+        case kPALFrame: return 25.0;
+        case kNTSCFrame: return 30.0;
+        case kShowScan: return 48.0;
+        case kPALField: return 50.0;
+        case kNTSCField: return 60.0;
+        case k100FPS: return 100.0;
+        case k120FPS: return 120.0;
+        default: return 24.0;
+    }
+}
+
+MTime::MTime(double value, Unit unit):
+    seconds(value / unitsPerSecond(unit)),
+    valueUnit(unit)
+{
+}
+
+double MTime::as(Unit unit) const
+{
+    MockMaya::count(kMockTimeAs);
+    return seconds * unitsPerSecond(unit);
+}
+
+double MTime::value() const
+{
+    return seconds * unitsPerSecond(valueUnit);
+}
+
+MTime MTime::inUiUnit(double seconds)
+{
+    return MTime(seconds * unitsPerSecond(currentUiUnit), currentUiUnit);
+}
+
+MTime::Unit MTime::uiUnit()
+{
+    MockMaya::count(kMockTimeUiUnit);
+    return currentUiUnit;
+}
+
+MStatus MTime::setUIUnit(Unit unit)
+{
+    currentUiUnit = unit;
+    return MS::kSuccess;
+}
+
+MTime MTime::operator+(const MTime &other) const
+{
+    return MTime(value() + other.seconds * unitsPerSecond(valueUnit), valueUnit);
+}
+
+MTime MTime::operator-(const MTime &other) const
+{
+    return MTime(value() - other.seconds * unitsPerSecond(valueUnit), valueUnit);
+}
+
+MTime MTime::operator+(double other) const
+{
+    return MTime(value() + other, valueUnit);
+}
+
+MTime MTime::operator-(double other) const
+{
+    return MTime(value() - other, valueUnit);
+}
+
+bool MTime::operator==(const MTime &other) const
+{
+    return fabs(seconds - other.seconds) < kTimeTolerance;
+}
+
+bool MTime::operator<(const MTime &other) const
+{
+    return seconds < other.seconds && !(*this == other);
+}
+
+/*
+ OBJECTS AND PLUGS
+ */
+
+MObject MObject::kNullObj;
+
+bool MObject::hasFn(MFn::Type type) const
+{
+    if (type == MFn::kAnimCurve)
+        return mockNode && mockNode->isAnimCurve;
+    if (type == MFn::kKeyframeDelta)
+        return mockDelta != NULL;
+    return mockDelta && mockDelta->type == type;
+}
+
+MObjectHandle::MObjectHandle(const MObject &object):
+    mockObject(object),
+    serial(object.mockNode ? object.mockNode->serial : 0)
+{
+}
+
+bool MObjectHandle::isValid() const
+{
+    return mockObject.mockNode && MockMaya::hasNode(mockObject.mockNode, serial);
+}
+
+MObject MPlug::node(MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockPlugNode);
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    return MObject(mockNode);
+}
+
+MString MPlug::name(MStatus *ReturnStatus) const
+{
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    if (!mockNode)
+        return MString();
+    return MString(mockNode->name + "." + attribute);
+}
+
+MString MPlug::partialName(bool includeNodeName, bool, bool, bool, bool, bool, MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockPlugPartialName);
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    if (!mockNode)
+        return MString();
+    return includeNodeName ? name() : MString(attribute);
+}
+
+double MPlug::asDouble(MStatus *ReturnStatus) const
+{
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    if (!mockNode)
+        return 0.0;
+
+    std::map<std::string, MockNode *>::const_iterator curve = mockNode->inputCurves.find(attribute);
+    if (curve != mockNode->inputCurves.end())
+        return MFnAnimCurve(MObject(curve->second)).evaluate(MAnimControl::currentTime());
+
+    std::map<std::string, double>::const_iterator value = mockNode->values.find(attribute);
+    return value != mockNode->values.end() ? value->second : 0.0;
+}
+
+MStatus MPlug::setDouble(double value)
+{
+    if (!mockNode)
+        return MS::kFailure;
+    mockNode->values[attribute] = value;
+    return MS::kSuccess;
+}
+
+MStatus MSelectionList::add(const MString &matchString, bool)
+{
+    std::string name = matchString.std();
+    size_t dot = name.find('.');
+    if (dot == std::string::npos)
+    {
+        MockNode *node = MockMaya::findNode(name);
+        if (!node)
+            return MS::kInvalidParameter;
+        plugs.push_back(MPlug(node, ""));
+        return MS::kSuccess;
+    }
+
+    MockNode *node = MockMaya::findNode(name.substr(0, dot));
+    if (!node)
+        return MS::kInvalidParameter;
+
+    plugs.push_back(MPlug(node, name.substr(dot + 1)));
+    return MS::kSuccess;
+}
+
+MStatus MSelectionList::getPlug(unsigned int index, MPlug &plug) const
+{
+    MockMaya::count(kMockSelectionGetPlug);
+    if (index >= plugs.size() || plugs[index].attribute.empty())
+        return MS::kFailure;
+    plug = plugs[index];
+    return MS::kSuccess;
+}
+
+MStatus MSelectionList::getDependNode(unsigned int index, MObject &object) const
+{
+    if (index >= plugs.size())
+        return MS::kFailure;
+    object = MObject(plugs[index].mockNode);
+    return MS::kSuccess;
+}
+
+MStatus MDagPath::getAPathTo(const MObject &object, MDagPath &path)
+{
+    if (object.isNull())
+        return MS::kFailure;
+    path.path = MString("|" + object.mockNode->name);
+    return MS::kSuccess;
+}
+
+// nodes are created straight away, doIt only brings back the ones removed by undoIt
+MStatus MDGModifier::doIt()
+{
+    for (unsigned int i = 0; i < createdNodes.size(); ++i)
+        createdNodes[i]->deleted = false;
+    return MS::kSuccess;
+}
+
+MStatus MDGModifier::undoIt()
+{
+    for (unsigned int i = 0; i < createdNodes.size(); ++i)
+        createdNodes[i]->deleted = true;
+    return MS::kSuccess;
+}
+
+MStatus MDGModifier::renameNode(const MObject &node, const MString &newName)
+{
+    MFnDependencyNode fnNode(node);
+    fnNode.setName(newName);
+    return MS::kSuccess;
+}
+
+/*
+ ANIMATION
+ */
+
+MFnDependencyNode::MFnDependencyNode(const MObject &object, MStatus *ReturnStatus):
+    mockNode(object.mockNode)
+{
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kInvalidParameter;
+}
+
+MString MFnDependencyNode::name(MStatus *ReturnStatus) const
+{
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    return mockNode ? MString(mockNode->name) : MString();
+}
+
+MString MFnDependencyNode::setName(const MString &name, bool, MStatus *ReturnStatus)
+{
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    if (!mockNode)
+        return MString();
+
+    // the scene looks nodes up by name, keep them unique as Maya does
+    std::string newName = name.asChar();
+    for (unsigned int i = 1; MockMaya::findNode(newName) && MockMaya::findNode(newName) != mockNode; ++i)
+    {
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), "%u", i);
+        newName = std::string(name.asChar()) + suffix;
+    }
+
+    mockNode->name = newName;
+    return MString(newName.c_str());
+}
+
+MFnAnimCurve::MFnAnimCurve(const MObject &object, MStatus *ReturnStatus)
+{
+    mockNode = object.mockNode && object.mockNode->isAnimCurve ? object.mockNode : NULL;
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kInvalidParameter;
+}
+
+MFnAnimCurve::MFnAnimCurve(const MPlug &plug, MStatus *ReturnStatus)
+{
+    mockNode = NULL;
+    if (plug.mockNode)
+    {
+        std::map<std::string, MockNode *>::const_iterator curve = plug.mockNode->inputCurves.find(plug.attribute);
+        if (curve != plug.mockNode->inputCurves.end() && !curve->second->deleted)
+            mockNode = curve->second;
+    }
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kInvalidParameter;
+}
+
+MObject MFnAnimCurve::create(AnimCurveType animCurveType, MDGModifier *modifier, MStatus *ReturnStatus)
+{
+    MockMaya::count(kMockCurveCreate);
+
+    char name[32];
+    static unsigned int numCreated = 0;
+    snprintf(name, sizeof(name), "animCurve%u", ++numCreated);
+
+    mockNode = MockMaya::createNode(name);
+    mockNode->isAnimCurve = true;
+    mockNode->animCurveType = animCurveType;
+    mockNode->curve.isWeighted = false;
+    if (modifier)
+        modifier->createdNodes.push_back(mockNode);
+
+    if (ReturnStatus)
+        *ReturnStatus = MS::kSuccess;
+    return MObject(mockNode);
+}
+
+MObject MFnAnimCurve::create(const MPlug &plug, MDGModifier *modifier, MStatus *ReturnStatus)
+{
+    MObject curve = create(kAnimCurveTL, modifier, ReturnStatus);
+    if (plug.mockNode)
+        plug.mockNode->inputCurves[plug.attribute] = mockNode;
+    return curve;
+}
+
+MFnAnimCurve::AnimCurveType MFnAnimCurve::timedAnimCurveTypeForPlug(MPlug &, MStatus *ReturnStatus) const
+{
+    if (ReturnStatus)
+        *ReturnStatus = MS::kSuccess;
+    return kAnimCurveTL;
+}
+
+MFnAnimCurve::AnimCurveType MFnAnimCurve::animCurveType(MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveType);
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    return mockNode ? (AnimCurveType)mockNode->animCurveType : kAnimCurveUnknown;
+}
+
+bool MFnAnimCurve::isValidKey(unsigned int index, MStatus *ReturnStatus) const
+{
+    bool valid = mockNode && index < mockNode->curve.keys.size();
+    if (ReturnStatus)
+        *ReturnStatus = valid ? MS::kSuccess : MS::kInvalidParameter;
+    return valid;
+}
+
+unsigned int MFnAnimCurve::numKeys(MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveNumKeys);
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    return mockNode ? (unsigned int)mockNode->curve.keys.size() : 0;
+}
+
+MTime MFnAnimCurve::time(unsigned int index, MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveTime);
+    if (!isValidKey(index, ReturnStatus))
+        return MTime();
+    // Maya returns the key times in the UI unit, fixCurve steps one frame from them
+    return MTime::inUiUnit(mockNode->curve.keys[index].time);
+}
+
+double MFnAnimCurve::value(unsigned int index, MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveValue);
+    if (!isValidKey(index, ReturnStatus))
+        return 0.0;
+    return mockNode->curve.keys[index].value;
+}
+
+double MFnAnimCurve::evaluate(const MTime &atTime, MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveEvaluate);
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    if (!mockNode || mockNode->curve.keys.empty())
+        return 0.0;
+
+    const std::vector<MockKey> &keys = mockNode->curve.keys;
+    double t = atTime.asSeconds();
+    if (t <= keys.front().time)
+        return keys.front().value;
+    if (t >= keys.back().time)
+        return keys.back().value;
+
+    unsigned int next = 1;
+    while (keys[next].time < t)
+        ++next;
+
+    const MockKey &previousKey = keys[next - 1];
+    if (previousKey.outTangentType == kTangentStep)
+        return previousKey.value;
+
+    double weight = (t - previousKey.time) / (keys[next].time - previousKey.time);
+    return previousKey.value + weight * (keys[next].value - previousKey.value);
+}
+
+bool MFnAnimCurve::find(const MTime &atTime, unsigned int &index, MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveFind);
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    if (!mockNode)
+        return false;
+
+    const std::vector<MockKey> &keys = mockNode->curve.keys;
+    for (unsigned int i = 0; i < keys.size(); ++i)
+    {
+        if (MTime(keys[i].time, MTime::kSeconds) == atTime)
+        {
+            index = i;
+            return true;
+        }
+        if (keys[i].time > atTime.asSeconds())
+            break;
+    }
+    return false;
+}
+
+unsigned int MFnAnimCurve::findClosest(const MTime &atTime, MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveFindClosest);
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    if (!mockNode || mockNode->curve.keys.empty())
+        return 0;
+
+    const std::vector<MockKey> &keys = mockNode->curve.keys;
+    const double t = atTime.asSeconds();
+    unsigned int low = 0, high = (unsigned int)keys.size() - 1;
+    while (low < high)
+    {
+        unsigned int middle = (low + high) / 2;
+        if (keys[middle].time < t)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low > 0 && t - keys[low - 1].time < keys[low].time - t)
+        --low;
+    return low;
+}
+
+unsigned int MFnAnimCurve::addKey(const MTime &atTime, double value, TangentType tangentInType, TangentType tangentOutType,
+                                  MAnimCurveChange *change, MStatus *ReturnStatus)
+{
+    MockMaya::count(kMockCurveAddKey);
+    return insertKey(atTime, value, tangentInType, tangentOutType, change, ReturnStatus);
+}
+
+unsigned int MFnAnimCurve::insertKey(const MTime &atTime, double value, TangentType tangentInType, TangentType tangentOutType,
+                                     MAnimCurveChange *change, MStatus *ReturnStatus)
+{
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    if (!mockNode)
+        return 0;
+    if (change)
+        change->record(mockNode);
+
+    MockKey key;
+    key.time = atTime.asSeconds();
+    key.value = value;
+    key.inTangentType = tangentInType;
+    key.outTangentType = tangentOutType;
+    key.inTangentX = key.outTangentX = 1.0f;
+    key.inTangentY = key.outTangentY = 0.0f;
+    key.tangentsLocked = true;
+    key.weightsLocked = true;
+
+    std::vector<MockKey> &keys = mockNode->curve.keys;
+    unsigned int index = 0;
+    while (index < keys.size() && keys[index].time < key.time && !(MTime(keys[index].time, MTime::kSeconds) == atTime))
+        ++index;
+
+    MFnKeyframeDeltaAddRemove::DeltaType deltaType = MFnKeyframeDeltaAddRemove::kAdded;
+    if (index < keys.size() && MTime(keys[index].time, MTime::kSeconds) == atTime)
+    {
+        keys[index] = key;
+        deltaType = MFnKeyframeDeltaAddRemove::kReplaced;
+    }
+    else
+        keys.insert(keys.begin() + index, key);
+
+    MAnimMessage::recordDelta(MFn::kKeyframeDeltaAddRemove, mockNode, index, key.time, key.time, deltaType);
+    return index;
+}
+
+MStatus MFnAnimCurve::addKeyframe(const MTime &atTime, double value, MAnimCurveChange *change)
+{
+    MockMaya::count(kMockCurveAddKeyframe);
+    MStatus status;
+    insertKey(atTime, value, kTangentGlobal, kTangentGlobal, change, &status);
+    return status;
+}
+
+MStatus MFnAnimCurve::remove(unsigned int index, MAnimCurveChange *change)
+{
+    MockMaya::count(kMockCurveRemove);
+    MStatus status;
+    if (!isValidKey(index, &status))
+        return status;
+    if (change)
+        change->record(mockNode);
+
+    const double time = mockNode->curve.keys[index].time;
+    mockNode->curve.keys.erase(mockNode->curve.keys.begin() + index);
+    MAnimMessage::recordDelta(MFn::kKeyframeDeltaAddRemove, mockNode, index, time, time, MFnKeyframeDeltaAddRemove::kRemoved);
+    return MS::kSuccess;
+}
+
+MFnAnimCurve::TangentType MFnAnimCurve::inTangentType(unsigned int index, MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveInTangentType);
+    if (!isValidKey(index, ReturnStatus))
+        return kTangentGlobal;
+    return (TangentType)mockNode->curve.keys[index].inTangentType;
+}
+
+MFnAnimCurve::TangentType MFnAnimCurve::outTangentType(unsigned int index, MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveOutTangentType);
+    if (!isValidKey(index, ReturnStatus))
+        return kTangentGlobal;
+    return (TangentType)mockNode->curve.keys[index].outTangentType;
+}
+
+MStatus MFnAnimCurve::getTangent(unsigned int index, float &x, float &y, bool inTangent) const
+{
+    MockMaya::count(kMockCurveGetTangent);
+    MStatus status;
+    if (!isValidKey(index, &status))
+        return status;
+
+    const MockKey &key = mockNode->curve.keys[index];
+    x = inTangent ? key.inTangentX : key.outTangentX;
+    y = inTangent ? key.inTangentY : key.outTangentY;
+    return MS::kSuccess;
+}
+
+MStatus MFnAnimCurve::setTangent(unsigned int index, float x, float y, bool inTangent, MAnimCurveChange *change, bool)
+{
+    MockMaya::count(kMockCurveSetTangent);
+    MStatus status;
+    if (!isValidKey(index, &status))
+        return status;
+    if (change)
+        change->record(mockNode);
+
+    MockKey &key = mockNode->curve.keys[index];
+    if (inTangent)
+    {
+        key.inTangentX = x;
+        key.inTangentY = y;
+    }
+    else
+    {
+        key.outTangentX = x;
+        key.outTangentY = y;
+    }
+    MAnimMessage::recordDelta(MFn::kKeyframeDeltaTangent, mockNode, index, key.time, key.time);
+    return MS::kSuccess;
+}
+
+bool MFnAnimCurve::tangentsLocked(unsigned int index, MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveTangentsLocked);
+    if (!isValidKey(index, ReturnStatus))
+        return false;
+    return mockNode->curve.keys[index].tangentsLocked;
+}
+
+bool MFnAnimCurve::weightsLocked(unsigned int index, MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveWeightsLocked);
+    if (!isValidKey(index, ReturnStatus))
+        return false;
+    return mockNode->curve.keys[index].weightsLocked;
+}
+
+MStatus MFnAnimCurve::setTangentsLocked(unsigned int index, bool locked, MAnimCurveChange *change)
+{
+    MockMaya::count(kMockCurveSetTangentsLocked);
+    MStatus status;
+    if (!isValidKey(index, &status))
+        return status;
+    if (change)
+        change->record(mockNode);
+
+    mockNode->curve.keys[index].tangentsLocked = locked;
+    MAnimMessage::recordDelta(MFn::kKeyframeDeltaTangent, mockNode, index, mockNode->curve.keys[index].time, mockNode->curve.keys[index].time);
+    return MS::kSuccess;
+}
+
+MStatus MFnAnimCurve::setWeightsLocked(unsigned int index, bool locked, MAnimCurveChange *change)
+{
+    MockMaya::count(kMockCurveSetWeightsLocked);
+    MStatus status;
+    if (!isValidKey(index, &status))
+        return status;
+    if (change)
+        change->record(mockNode);
+
+    mockNode->curve.keys[index].weightsLocked = locked;
+    MAnimMessage::recordDelta(MFn::kKeyframeDeltaTangent, mockNode, index, mockNode->curve.keys[index].time, mockNode->curve.keys[index].time);
+    return MS::kSuccess;
+}
+
+bool MFnAnimCurve::isWeighted(MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockCurveIsWeighted);
+    if (ReturnStatus)
+        *ReturnStatus = mockNode ? MS::kSuccess : MS::kFailure;
+    return mockNode ? mockNode->curve.isWeighted : false;
+}
+
+MStatus MFnAnimCurve::setIsWeighted(bool isWeighted, MAnimCurveChange *change)
+{
+    MockMaya::count(kMockCurveSetIsWeighted);
+    if (!mockNode)
+        return MS::kFailure;
+    if (change)
+        change->record(mockNode);
+
+    mockNode->curve.isWeighted = isWeighted;
+    MAnimMessage::recordDelta(MFn::kKeyframeDelta, mockNode, 0, 0.0, 0.0);
+    return MS::kSuccess;
+}
+
+/*
+ MESSAGES
+ */
+
+MCallbackId MMessage::nextId = 1;
+std::vector<MAnimMessage::Callback> MAnimMessage::callbacks;
+std::vector<MockKeyframeDelta *> MAnimMessage::deltas;
+std::vector<MSceneMessage::Callback> MSceneMessage::callbacks;
+
+MFnKeyframeDelta::MFnKeyframeDelta(const MObject &object, MStatus *ReturnStatus):
+    mockDelta(object.mockDelta)
+{
+    if (ReturnStatus)
+        *ReturnStatus = mockDelta ? MS::kSuccess : MS::kInvalidParameter;
+}
+
+MObject MFnKeyframeDelta::paramCurve(MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockKeyframeDelta);
+    if (ReturnStatus)
+        *ReturnStatus = mockDelta ? MS::kSuccess : MS::kFailure;
+    return mockDelta ? MObject(mockDelta->curve) : MObject();
+}
+
+unsigned int MFnKeyframeDelta::keyIndex(MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockKeyframeDelta);
+    if (ReturnStatus)
+        *ReturnStatus = mockDelta ? MS::kSuccess : MS::kFailure;
+    return mockDelta ? mockDelta->keyIndex : 0;
+}
+
+MFnKeyframeDeltaAddRemove::DeltaType MFnKeyframeDeltaAddRemove::deltaType(MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockKeyframeDelta);
+    if (ReturnStatus)
+        *ReturnStatus = mockDelta ? MS::kSuccess : MS::kFailure;
+    return mockDelta ? (DeltaType)mockDelta->addRemoveType : kAdded;
+}
+
+MTime MFnKeyframeDeltaAddRemove::time(MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockKeyframeDelta);
+    if (ReturnStatus)
+        *ReturnStatus = mockDelta ? MS::kSuccess : MS::kFailure;
+    return MTime::inUiUnit(mockDelta ? mockDelta->time : 0.0);
+}
+
+MTime MFnKeyframeDeltaMove::currentTime(MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockKeyframeDelta);
+    if (ReturnStatus)
+        *ReturnStatus = mockDelta ? MS::kSuccess : MS::kFailure;
+    return MTime::inUiUnit(mockDelta ? mockDelta->time : 0.0);
+}
+
+MTime MFnKeyframeDeltaMove::previousTime(MStatus *ReturnStatus) const
+{
+    MockMaya::count(kMockKeyframeDelta);
+    if (ReturnStatus)
+        *ReturnStatus = mockDelta ? MS::kSuccess : MS::kFailure;
+    return MTime::inUiUnit(mockDelta ? mockDelta->previousTime : 0.0);
+}
+
+MStatus MMessage::removeCallback(MCallbackId id)
+{
+    for (unsigned int i = 0; i < MAnimMessage::callbacks.size(); ++i)
+        if (MAnimMessage::callbacks[i].id == id)
+        {
+            MAnimMessage::callbacks.erase(MAnimMessage::callbacks.begin() + i);
+            return MS::kSuccess;
+        }
+
+    for (unsigned int i = 0; i < MSceneMessage::callbacks.size(); ++i)
+        if (MSceneMessage::callbacks[i].id == id)
+        {
+            MSceneMessage::callbacks.erase(MSceneMessage::callbacks.begin() + i);
+            return MS::kSuccess;
+        }
+
+    return MS::kInvalidParameter;
+}
+
+MStatus MMessage::removeCallbacks(MCallbackIdArray &ids)
+{
+    MStatus status;
+    for (unsigned int i = 0; i < ids.length(); ++i)
+        if (!removeCallback(ids[i]))
+            status = MS::kInvalidParameter;
+    return status;
+}
+
+MCallbackId MAnimMessage::addAnimKeyframeEditedCallback(MObjectArrayFunction func, void *clientData, MStatus *ReturnStatus)
+{
+    if (ReturnStatus)
+        *ReturnStatus = MS::kSuccess;
+
+    Callback callback;
+    callback.id = nextId++;
+    callback.func = func;
+    callback.clientData = clientData;
+    callbacks.push_back(callback);
+    return callback.id;
+}
+
+void MAnimMessage::flushAnimKeyframeEditedCallbacks()
+{
+    if (deltas.empty())
+        return;
+
+    MObjectArray objects;
+    for (unsigned int i = 0; i < deltas.size(); ++i)
+        objects.append(MObject(deltas[i]));
+
+    // a callback could remove itself
+    std::vector<Callback> called = callbacks;
+    for (unsigned int i = 0; i < called.size(); ++i)
+        called[i].func(objects, called[i].clientData);
+
+    clearDeltas();
+}
+
+void MAnimMessage::recordDelta(const MFn::Type type, MockNode *curve, const unsigned int keyIndex, const double time, const double previousTime,
+                               const int addRemoveType)
+{
+    if (callbacks.empty())
+        return;
+
+    MockKeyframeDelta *delta = new MockKeyframeDelta;
+    delta->type = type;
+    delta->curve = curve;
+    delta->keyIndex = keyIndex;
+    delta->time = time;
+    delta->previousTime = previousTime;
+    delta->addRemoveType = addRemoveType;
+    deltas.push_back(delta);
+}
+
+void MAnimMessage::clearDeltas()
+{
+    for (unsigned int i = 0; i < deltas.size(); ++i)
+        delete deltas[i];
+    deltas.clear();
+}
+
+MCallbackId MSceneMessage::addCallback(Message message, MMessage::MBasicFunction func, void *clientData, MStatus *ReturnStatus)
+{
+    if (ReturnStatus)
+        *ReturnStatus = MS::kSuccess;
+
+    Callback callback;
+    callback.id = nextId++;
+    callback.message = message;
+    callback.func = func;
+    callback.clientData = clientData;
+    callbacks.push_back(callback);
+    return callback.id;
+}
+
+void MSceneMessage::notify(Message message)
+{
+    std::vector<Callback> called = callbacks;
+    for (unsigned int i = 0; i < called.size(); ++i)
+        if (called[i].message == message)
+            called[i].func(called[i].clientData);
+}
+
+void MAnimCurveChange::record(MockNode *node)
+{
+    if (std::find(nodes.begin(), nodes.end(), node) != nodes.end())
+        return;
+
+    nodes.push_back(node);
+    before.push_back(node->curve);
+    after.push_back(node->curve);
+}
+
+MStatus MAnimCurveChange::undoIt()
+{
+    MockMaya::count(kMockCurveChangeUndo);
+    for (int i = (int)nodes.size() - 1; i >= 0; --i)
+    {
+        after[i] = nodes[i]->curve;
+        nodes[i]->curve = before[i];
+    }
+    return MS::kSuccess;
+}
+
+MStatus MAnimCurveChange::redoIt()
+{
+    MockMaya::count(kMockCurveChangeRedo);
+    for (unsigned int i = 0; i < nodes.size(); ++i)
+        nodes[i]->curve = after[i];
+    return MS::kSuccess;
+}
+
+static MTime mockCurrentTime(0.0, MTime::kFilm);
+
+MTime MAnimControl::currentTime()
+{
+    return mockCurrentTime;
+}
+
+MStatus MAnimControl::setCurrentTime(const MTime &time)
+{
+    mockCurrentTime = time;
+    return MS::kSuccess;
+}
+
+MTime MAnimControl::minTime()
+{
+    return MTime(1.0, MTime::kFilm);
+}
+
+MTime MAnimControl::maxTime()
+{
+    return MTime(120.0, MTime::kFilm);
+}
+
+/*
+ COMMANDS
+ */
+
+MString MArgList::asString(unsigned int index, MStatus *ReturnStatus) const
+{
+    if (ReturnStatus)
+        *ReturnStatus = index < args.size() ? MS::kSuccess : MS::kFailure;
+    return index < args.size() ? args[index] : MString();
+}
+
+double MArgList::asDouble(unsigned int index, MStatus *ReturnStatus) const
+{
+    return asString(index, ReturnStatus).asDouble();
+}
+
+int MArgList::asInt(unsigned int index, MStatus *ReturnStatus) const
+{
+    return asString(index, ReturnStatus).asInt();
+}
+
+MArgList &MArgList::addArg(double arg)
+{
+    MString value;
+    value += arg;
+    return addArg(value);
+}
+
+MArgList &MArgList::addArg(int arg)
+{
+    MString value;
+    value += arg;
+    return addArg(value);
+}
+
+MStatus MSyntax::addFlag(const char *shortName, const char *longName, MArgType argType1, MArgType argType2,
+                         MArgType argType3, MArgType argType4, MArgType argType5, MArgType argType6)
+{
+    Flag flag;
+    flag.shortName = shortName;
+    flag.longName = longName;
+    flag.multiUse = false;
+
+    MArgType argTypes[6] = {argType1, argType2, argType3, argType4, argType5, argType6};
+    for (unsigned int i = 0; i < 6 && argTypes[i] != kNoArg; ++i)
+        flag.argTypes.push_back(argTypes[i]);
+
+    flags.push_back(flag);
+    return MS::kSuccess;
+}
+
+MStatus MSyntax::makeFlagMultiUse(const char *flagName)
+{
+    int flag = findFlag(flagName);
+    if (flag == -1)
+        return MS::kInvalidParameter;
+    flags[flag].multiUse = true;
+    return MS::kSuccess;
+}
+
+int MSyntax::findFlag(const std::string &flagName) const
+{
+    for (unsigned int i = 0; i < flags.size(); ++i)
+        if (flags[i].shortName == flagName || flags[i].longName == flagName)
+            return i;
+    return -1;
+}
+
+unsigned int MSyntax::numFlagArgs(int flag) const
+{
+    return (unsigned int)flags[flag].argTypes.size();
+}
+
+MArgDatabase::MArgDatabase(const MSyntax &argSyntax, const MArgList &args, MStatus *ReturnStatus):
+    syntax(argSyntax)
+{
+    if (ReturnStatus)
+        *ReturnStatus = MS::kSuccess;
+
+    unsigned int i = 0;
+    while (i < args.flagTokens.size())
+    {
+        int flag = syntax.findFlag(args.flagTokens[i].std());
+        if (flag == -1)
+        {
+            if (ReturnStatus)
+                *ReturnStatus = MS::kInvalidParameter;
+            return;
+        }
+
+        std::vector<MString> flagArgs;
+        unsigned int numFlagArgs = syntax.numFlagArgs(flag);
+        for (unsigned int j = 1; j <= numFlagArgs && i + j < args.flagTokens.size(); ++j)
+            flagArgs.push_back(args.flagTokens[i + j]);
+        uses[flag].push_back(flagArgs);
+
+        i += numFlagArgs + 1;
+    }
+}
+
+bool MArgDatabase::isFlagSet(const char *flag, MStatus *ReturnStatus) const
+{
+    if (ReturnStatus)
+        *ReturnStatus = MS::kSuccess;
+    return uses.find(syntax.findFlag(flag)) != uses.end();
+}
+
+unsigned int MArgDatabase::numberOfFlagUses(const char *flag) const
+{
+    std::map<int, std::vector<std::vector<MString> > >::const_iterator it = uses.find(syntax.findFlag(flag));
+    return it == uses.end() ? 0 : (unsigned int)it->second.size();
+}
+
+const MString *MArgDatabase::flagArgument(const char *flag, unsigned int use, unsigned int index) const
+{
+    std::map<int, std::vector<std::vector<MString> > >::const_iterator it = uses.find(syntax.findFlag(flag));
+    if (it == uses.end() || use >= it->second.size() || index >= it->second[use].size())
+        return NULL;
+    return &it->second[use][index];
+}
+
+MStatus MArgDatabase::getFlagArgument(const char *flag, unsigned int index, bool &result) const
+{
+    const MString *arg = flagArgument(flag, 0, index);
+    if (!arg)
+        return MS::kFailure;
+    result = *arg == "true" || *arg == "on" || arg->asInt() != 0;
+    return MS::kSuccess;
+}
+
+MStatus MArgDatabase::getFlagArgument(const char *flag, unsigned int index, int &result) const
+{
+    const MString *arg = flagArgument(flag, 0, index);
+    if (!arg)
+        return MS::kFailure;
+    result = (int)arg->asDouble();
+    return MS::kSuccess;
+}
+
+MStatus MArgDatabase::getFlagArgument(const char *flag, unsigned int index, unsigned int &result) const
+{
+    const MString *arg = flagArgument(flag, 0, index);
+    if (!arg)
+        return MS::kFailure;
+    result = (unsigned int)arg->asDouble();
+    return MS::kSuccess;
+}
+
+MStatus MArgDatabase::getFlagArgument(const char *flag, unsigned int index, double &result) const
+{
+    const MString *arg = flagArgument(flag, 0, index);
+    if (!arg)
+        return MS::kFailure;
+    result = arg->asDouble();
+    return MS::kSuccess;
+}
+
+MStatus MArgDatabase::getFlagArgument(const char *flag, unsigned int index, MString &result) const
+{
+    const MString *arg = flagArgument(flag, 0, index);
+    if (!arg)
+        return MS::kFailure;
+    result = *arg;
+    return MS::kSuccess;
+}
+
+MStatus MArgDatabase::getFlagArgumentList(const char *flag, unsigned int use, MArgList &args) const
+{
+    std::map<int, std::vector<std::vector<MString> > >::const_iterator it = uses.find(syntax.findFlag(flag));
+    if (it == uses.end() || use >= it->second.size())
+        return MS::kFailure;
+
+    args = MArgList();
+    for (unsigned int i = 0; i < it->second[use].size(); ++i)
+        args.addArg(it->second[use][i]);
+    return MS::kSuccess;
+}
+
+void MPxCommand::clearResult()
+{
+    MockMaya::commandResult.clear();
+}
+
+void MPxCommand::setResult(bool result)
+{
+    clearResult();
+    MockMaya::commandResult.push_back(result ? "1" : "0");
+}
+
+void MPxCommand::setResult(int result)
+{
+    clearResult();
+    appendToResult(result);
+}
+
+void MPxCommand::setResult(unsigned int result)
+{
+    clearResult();
+    appendToResult((int)result);
+}
+
+void MPxCommand::setResult(double result)
+{
+    clearResult();
+    appendToResult(result);
+}
+
+void MPxCommand::setResult(const MString &result)
+{
+    clearResult();
+    appendToResult(result);
+}
+
+void MPxCommand::setResult(const MIntArray &result)
+{
+    clearResult();
+    for (unsigned int i = 0; i < result.length(); ++i)
+        appendToResult(result[i]);
+}
+
+void MPxCommand::setResult(const MDoubleArray &result)
+{
+    clearResult();
+    for (unsigned int i = 0; i < result.length(); ++i)
+        appendToResult(result[i]);
+}
+
+void MPxCommand::setResult(const MStringArray &result)
+{
+    clearResult();
+    for (unsigned int i = 0; i < result.length(); ++i)
+        appendToResult(result[i]);
+}
+
+void MPxCommand::appendToResult(int result)
+{
+    MString value;
+    value += result;
+    MockMaya::commandResult.push_back(value);
+}
+
+void MPxCommand::appendToResult(double result)
+{
+    MString value;
+    value += result;
+    MockMaya::commandResult.push_back(value);
+}
+
+void MPxCommand::appendToResult(const MString &result)
+{
+    MockMaya::commandResult.push_back(result);
+}
+
+void MGlobal::displayInfo(const MString &message)
+{
+    if (MockMaya::verbose)
+        fprintf(stdout, "%s\n", message.asChar());
+}
+
+void MGlobal::displayWarning(const MString &message)
+{
+    fprintf(stderr, "Warning: %s\n", message.asChar());
+}
+
+void MGlobal::displayError(const MString &message)
+{
+    fprintf(stderr, "Error: %s\n", message.asChar());
+}
+
+MStatus MGlobal::executeCommand(const MString &command, bool, bool)
+{
+    if (MockMaya::verbose)
+        fprintf(stdout, "executeCommand is not available headless: %s\n", command.asChar());
+    return MS::kNotImplemented;
+}
+
+/*
+ THREADS
+ */
+
+MStatus MThreadPool::newParallelRegion(MThreadCallbackFunc func, void *data)
+{
+    MThreadRootTask root;
+    func(data, &root);
+    return MS::kSuccess;
+}
+
+MStatus MThreadPool::createTask(MThreadFunc func, void *data, MThreadRootTask *root)
+{
+    root->tasks.push_back(std::make_pair(func, data));
+    return MS::kSuccess;
+}
+
+MStatus MThreadPool::executeAndJoin(MThreadRootTask *root)
+{
+    for (unsigned int i = 0; i < root->tasks.size(); ++i)
+        root->tasks[i].first(root->tasks[i].second);
+    root->tasks.clear();
+    return MS::kSuccess;
+}
+
+class MockAsyncTask
+{
+public:
+    MThreadFunc func;
+    void *data;
+    void (*doneFunc)(void *);
+    void *doneData;
+};
+
+static pthread_mutex_t asyncMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t asyncFinished = PTHREAD_COND_INITIALIZER;
+static unsigned int numAsyncTasks = 0;
+
+static void *runAsyncTask(void *data)
+{
+    MockAsyncTask *task = (MockAsyncTask *)data;
+    task->func(task->data);
+    if (task->doneFunc)
+        task->doneFunc(task->doneData);
+    delete task;
+
+    pthread_mutex_lock(&asyncMutex);
+    numAsyncTasks--;
+    pthread_cond_broadcast(&asyncFinished);
+    pthread_mutex_unlock(&asyncMutex);
+    return NULL;
+}
+
+MStatus MThreadAsync::createTask(MThreadFunc func, void *data, void (*doneFunc)(void *), void *doneData)
+{
+    MockAsyncTask *task = new MockAsyncTask;
+    task->func = func;
+    task->data = data;
+    task->doneFunc = doneFunc;
+    task->doneData = doneData;
+
+    pthread_mutex_lock(&asyncMutex);
+    numAsyncTasks++;
+    pthread_mutex_unlock(&asyncMutex);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, runAsyncTask, task) != 0)
+    {
+        pthread_mutex_lock(&asyncMutex);
+        numAsyncTasks--;
+        pthread_mutex_unlock(&asyncMutex);
+        delete task;
+        return MS::kFailure;
+    }
+
+    pthread_detach(thread);
+    return MS::kSuccess;
+}
+
+void MThreadAsync::release()
+{
+    pthread_mutex_lock(&asyncMutex);
+    while (numAsyncTasks > 0)
+        pthread_cond_wait(&asyncFinished, &asyncMutex);
+    pthread_mutex_unlock(&asyncMutex);
+}
+
+MSpinLock::MSpinLock()
+{
+    pthread_mutex_init(&mutex, NULL);
+}
+
+MSpinLock::~MSpinLock()
+{
+    pthread_mutex_destroy(&mutex);
+}
+
+void MSpinLock::lock()
+{
+    pthread_mutex_lock(&mutex);
+}
+
+void MSpinLock::unlock()
+{
+    pthread_mutex_unlock(&mutex);
+}
+
+bool MSpinLock::tryLock()
+{
+    return pthread_mutex_trylock(&mutex) == 0;
+}
+
+int MThreadUtils::getNumThreads()
+{
+    long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    return numThreads > 0 ? (int)numThreads : 1;
+}
@@ -0,0 +1,328 @@
+//
+//  callBudgets.cpp
+//  keyReducer
+//
+//
+
+// Runs the commands headless on a fixed scene and fails when one of them makes more Maya API
+// calls than its budget. The budgets leave a little room over the counts measured when they
+// were set, lower them when a change saves calls.
+// It also fails when a reduction breaks its tolerance across the window seams, keeps more keys
+// than -maxKeys or when -levels doesn't give the same keys as a plain reduction.
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "mockMaya.h"
+#include "keyReducerCmd.h"
+#include "restoreKeys.h"
+
+static const int kNumCurves = 8;
+static const int kNumKeys = 2000;
+
+static int failures = 0;
+
+static void checkBudget(const char *name, const unsigned long budget)
+{
+    unsigned long calls = MockMaya::totalCalls();
+    printf("%-28s %9lu calls, budget %9lu%s\n", name, calls, budget, calls > budget ? "  OVER BUDGET" : "");
+    if (calls > budget)
+    {
+        for (int i = 0; i < kMockNumCalls; ++i)
+            if (MockMaya::calls((MockCall)i))
+                printf("    %-32s %lu\n", MockMaya::callName((MockCall)i), MockMaya::calls((MockCall)i));
+        failures++;
+    }
+}
+
+static void checkResult(const char *name, const bool ok)
+{
+    printf("%-28s %s\n", name, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+static void buildScene()
+{
+    MockMaya::reset();
+    for (int c = 0; c < kNumCurves; ++c)
+    {
+        char name[64];
+        sprintf(name, "locator%d.tx", c);
+        MFnAnimCurve fnCurve(MockMaya::addAnimCurve(name));
+
+        // holds, smooth motion and a few stepped poses, so the pre-pass and fixCurve have work to do
+        for (int i = 0; i < kNumKeys; ++i)
+        {
+            double value = (i % 200) < 50 ? 1.0 : sin(i * 0.05 + c) * 10.0;
+            MFnAnimCurve::TangentType tangent = (i % 500) >= 495 ? MFnAnimCurve::kTangentStep : MFnAnimCurve::kTangentLinear;
+            fnCurve.addKey(MTime((double)i), value, tangent, tangent);
+        }
+    }
+}
+
+// no holds here, fixCurve adds keys next to them that the tolerance doesn't cover
+static bool smoothStepped(const int key)
+{
+    return (key % 500) >= 480;
+}
+
+static double smoothValue(const int curve, const int key)
+{
+    double value = sin(key * 0.05 + curve) * 10.0 + ((key * 7919 + curve * 104729) % 100) * 0.002;
+    return smoothStepped(key) ? floor(value) : value;
+}
+
+static void buildSmoothScene()
+{
+    MockMaya::reset();
+    for (int c = 0; c < kNumCurves; ++c)
+    {
+        char name[64];
+        sprintf(name, "locator%d.tx", c);
+        MFnAnimCurve fnCurve(MockMaya::addAnimCurve(name));
+
+        for (int i = 0; i < kNumKeys; ++i)
+        {
+            MFnAnimCurve::TangentType tangent = smoothStepped(i) ? MFnAnimCurve::kTangentStep : MFnAnimCurve::kTangentLinear;
+            fnCurve.addKey(MTime((double)i), smoothValue(c, i), tangent, tangent);
+        }
+    }
+}
+
+static MFnAnimCurve findCurve(const char *format, const int curve)
+{
+    char name[64];
+    sprintf(name, format, curve);
+    return MFnAnimCurve(MObject(MockMaya::findNode(name)));
+}
+
+// the biggest distance between the keys of buildSmoothScene and the reduced curves
+static double smoothError()
+{
+    double error = 0.0;
+    for (int c = 0; c < kNumCurves; ++c)
+    {
+        MFnAnimCurve fnCurve = findCurve("locator%d_tx", c);
+        unsigned int k = 0;
+        for (int i = 0; i < kNumKeys; ++i)
+        {
+            while (k + 1 < fnCurve.numKeys() && fnCurve.time(k + 1).as(MTime::uiUnit()) <= i)
+                k++;
+
+            const double time = fnCurve.time(k).as(MTime::uiUnit());
+            double distance;
+            if (time == i || smoothStepped((int)time))
+                distance = fabs(smoothValue(c, i) - fnCurve.value(k));
+            else
+                distance = getDeviation(fnCurve.value(k), time, fnCurve.value(k + 1), fnCurve.time(k + 1).as(MTime::uiUnit()), smoothValue(c, i), i);
+
+            if (distance > error)
+                error = distance;
+        }
+    }
+    return error;
+}
+
+struct CurveKeys
+{
+    std::vector<double> times;
+    std::vector<double> values;
+};
+
+static void readKeys(const MFnAnimCurve &fnCurve, CurveKeys &keys)
+{
+    keys.times.clear();
+    keys.values.clear();
+    for (unsigned int k = 0; k < fnCurve.numKeys(); ++k)
+    {
+        keys.times.push_back(fnCurve.time(k).as(MTime::uiUnit()));
+        keys.values.push_back(fnCurve.value(k));
+    }
+}
+
+static MArgList curveArgs()
+{
+    MArgList args;
+    for (int c = 0; c < kNumCurves; ++c)
+    {
+        char name[64];
+        sprintf(name, "locator%d.tx", c);
+        args.addArg(MString(name));
+    }
+    return args;
+}
+
+static MStatus runReducer(KeyReducerCmd &command, MArgList args)
+{
+    MockMaya::resetCalls();
+    return MockMaya::runCommand(command, KeyReducerCmd::syntaxCreator, args);
+}
+
+int main()
+{
+    // the plugin registers it when loaded, -incremental finds the edits through it
+    KeyReducerCmd::addCallbacks();
+    buildScene();
+
+    {
+        StoreKeysCmd store;
+        MockMaya::resetCalls();
+        MockMaya::runCommand(store, StoreKeysCmd::syntaxCreator, curveArgs());
+        checkBudget("tcStoreKeys", 176000);
+    }
+
+    {
+        MArgList args = curveArgs();
+        args.addArg(MString("-value"));
+        args.addArg(MString("0.3"));
+
+        KeyReducerCmd *command = (KeyReducerCmd *)KeyReducerCmd::creator();
+        runReducer(*command, args);
+        checkBudget("tcKeyReducer", 200000);
+
+        MockMaya::resetCalls();
+        command->undoIt();
+        checkBudget("tcKeyReducer undo", 10);
+
+        MockMaya::resetCalls();
+        command->redoIt();
+        checkBudget("tcKeyReducer redo", 10);
+        delete command;
+    }
+
+    {
+        RestoreKeysCmd restore;
+        MockMaya::resetCalls();
+        MockMaya::runCommand(restore, RestoreKeysCmd::syntaxCreator, MArgList());
+        checkBudget("tcRestoreKeys", 125000);
+    }
+
+    {
+        MArgList args = curveArgs();
+        args.addArg(MString("-value"));
+        args.addArg(MString("0.3"));
+        args.addArg(MString("-windowSize"));
+        args.addArg(MString("250"));
+
+        KeyReducerCmd *command = (KeyReducerCmd *)KeyReducerCmd::creator();
+        runReducer(*command, args);
+        checkBudget("tcKeyReducer -windowSize", 204000);
+        delete command;
+    }
+
+    buildScene();
+
+    {
+        MArgList args = curveArgs();
+        args.addArg(MString("-maxKeys"));
+        args.addArg(MString("150"));
+
+        KeyReducerCmd *command = (KeyReducerCmd *)KeyReducerCmd::creator();
+        runReducer(*command, args);
+        checkBudget("tcKeyReducer -maxKeys", 305000);
+        delete command;
+
+        bool withinBudget = true;
+        for (int c = 0; c < kNumCurves; ++c)
+            if (findCurve("locator%d_tx", c).numKeys() > 150)
+                withinBudget = false;
+        checkResult("-maxKeys key counts", withinBudget);
+    }
+
+    buildSmoothScene();
+
+    {
+        // small windows so most of the kept keys sit next to a seam
+        MArgList args = curveArgs();
+        args.addArg(MString("-value"));
+        args.addArg(MString("0.5"));
+        args.addArg(MString("-windowSize"));
+        args.addArg(MString("37"));
+
+        KeyReducerCmd *command = (KeyReducerCmd *)KeyReducerCmd::creator();
+        runReducer(*command, args);
+        delete command;
+
+        checkResult("-windowSize tolerance", smoothError() <= 0.5 + 1e-9);
+    }
+
+    buildScene();
+
+    {
+        const char *values[] = {"0.3", "1.0"};
+        std::vector<CurveKeys> levelKeys(kNumCurves * 2);
+
+        MArgList args = curveArgs();
+        for (int level = 0; level < 2; ++level)
+        {
+            args.addArg(MString("-levels"));
+            args.addArg(MString(values[level]));
+        }
+
+        KeyReducerCmd *command = (KeyReducerCmd *)KeyReducerCmd::creator();
+        runReducer(*command, args);
+        delete command;
+
+        for (int c = 0; c < kNumCurves; ++c)
+        {
+            readKeys(findCurve("locator%d_tx_lod0", c), levelKeys[c * 2]);
+            readKeys(findCurve("locator%d_tx_lod1", c), levelKeys[c * 2 + 1]);
+        }
+
+        bool sameKeys = true;
+        for (int level = 0; level < 2; ++level)
+        {
+            buildScene();
+
+            MArgList plainArgs = curveArgs();
+            plainArgs.addArg(MString("-value"));
+            plainArgs.addArg(MString(values[level]));
+
+            command = (KeyReducerCmd *)KeyReducerCmd::creator();
+            runReducer(*command, plainArgs);
+            delete command;
+
+            for (int c = 0; c < kNumCurves; ++c)
+            {
+                CurveKeys plainKeys;
+                readKeys(findCurve("locator%d_tx", c), plainKeys);
+                if (plainKeys.times != levelKeys[c * 2 + level].times || plainKeys.values != levelKeys[c * 2 + level].values)
+                    sameKeys = false;
+            }
+        }
+        checkResult("-levels keys", sameKeys);
+    }
+
+    buildScene();
+
+    {
+        MArgList args;
+        args.addArg(MString("locator0.tx"));
+        args.addArg(MString("-incremental"));
+
+        KeyReducerCmd *command = (KeyReducerCmd *)KeyReducerCmd::creator();
+        runReducer(*command, args);
+        delete command;
+
+        // one key edited in the middle of the curve
+        MFnAnimCurve fnCurve(MObject(MockMaya::findNode("locator0_tx")));
+        fnCurve.addKey(MTime(1000.5), 30.0, MFnAnimCurve::kTangentLinear, MFnAnimCurve::kTangentLinear);
+
+        command = (KeyReducerCmd *)KeyReducerCmd::creator();
+        runReducer(*command, args);
+        checkBudget("tcKeyReducer -incremental", 650);
+        delete command;
+    }
+
+    if (failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all commands within budget and checks passed\n");
+    return 0;
+}
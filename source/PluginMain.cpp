@@ -1,8 +1,14 @@
 #include <maya/MFnPlugin.h>
 #include <maya/MGlobal.h>
+#include <maya/MThreadPool.h>
+#include <maya/MThreadAsync.h>
 
 #include "keyReducerCmd.h"
 #include "restoreKeys.h"
+#include "reductionCache.h"
+#include "keyReducerNode.h"
+#include "autoCompress.h"
+#include "keyRecorder.h"
 
 
 MStatus initializePlugin( MObject obj )
@@ -32,6 +38,59 @@ MStatus initializePlugin( MObject obj )
 		return status;
 	}
     
+    status = plugin.registerCommand("tcKeyReducerCache", ReductionCacheCmd::creator, ReductionCacheCmd::syntaxCreator);
+	if(!status)
+	{
+		MGlobal::displayError("Error registering tcKeyReducerCache");
+		return status;
+	}
+    
+    status = plugin.registerNode("tcKeyReducerNode", KeyReducerNode::id, KeyReducerNode::creator, KeyReducerNode::initialize);
+	if(!status)
+	{
+		MGlobal::displayError("Error registering tcKeyReducerNode");
+		return status;
+	}
+    
+    status = plugin.registerCommand("tcKeyReducerAutoCompress", AutoCompressCmd::creator, AutoCompressCmd::syntaxCreator);
+	if(!status)
+	{
+		MGlobal::displayError("Error registering tcKeyReducerAutoCompress");
+		return status;
+	}
+    
+    status = plugin.registerCommand("tcKeyRecorder", KeyRecorderCmd::creator, KeyRecorderCmd::syntaxCreator);
+	if(!status)
+	{
+		MGlobal::displayError("Error registering tcKeyRecorder");
+		return status;
+	}
+    
+    // the pools live as long as the plugin, the commands don't pay for starting threads
+    status = MThreadPool::init();
+    if (status)
+        status = MThreadAsync::init();
+	if(!status)
+	{
+		MGlobal::displayError("Error initializing the tcKeyReducer thread pools");
+		return status;
+	}
+    
+    AutoCompress::loadSettings();
+    status = AutoCompress::addCallbacks();
+	if(!status)
+	{
+		MGlobal::displayError("Error adding the tcKeyReducer scene callbacks");
+		return status;
+	}
+    
+    status = KeyReducerCmd::addCallbacks();
+	if(!status)
+	{
+		MGlobal::displayError("Error adding the tcKeyReducer keyframe callback");
+		return status;
+	}
+    
 	MString addMenu;
 	addMenu +=
 	"global proc loadTcKeyReducer()\
@@ -145,6 +204,7 @@ MStatus uninitializePlugin( MObject obj)
 {
 	MStatus status = MStatus::kSuccess;
 	MFnPlugin plugin( obj );
+    KeyReducerCmd::removeCallbacks();
 	status = plugin.deregisterCommand("tcKeyReducer");
     if (!status)
 	{
@@ -165,6 +225,41 @@ MStatus uninitializePlugin( MObject obj)
 		MGlobal::displayError("Error deregistering node tcRestoreKeys");
 		return status;
 	}
+    
+    status = plugin.deregisterCommand("tcKeyReducerCache");
+    if (!status)
+	{
+		MGlobal::displayError("Error deregistering node tcKeyReducerCache");
+		return status;
+	}
+    
+    status = plugin.deregisterNode(KeyReducerNode::id);
+    if (!status)
+	{
+		MGlobal::displayError("Error deregistering node tcKeyReducerNode");
+		return status;
+	}
+    
+    AutoCompress::removeCallbacks();
+    status = plugin.deregisterCommand("tcKeyReducerAutoCompress");
+    if (!status)
+	{
+		MGlobal::displayError("Error deregistering tcKeyReducerAutoCompress");
+		return status;
+	}
+    
+    status = plugin.deregisterCommand("tcKeyRecorder");
+    if (!status)
+	{
+		MGlobal::displayError("Error deregistering tcKeyRecorder");
+		return status;
+	}
+    
+    if (ReductionCache::filePath.length() != 0)
+        ReductionCache::save();
+    
+    MThreadAsync::release();
+    MThreadPool::release();
         
 	return status;
 }
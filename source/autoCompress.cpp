@@ -0,0 +1,393 @@
+#include <maya/MItDependencyNodes.h>
+#include <maya/MFnAnimCurve.h>
+#include <maya/MPlug.h>
+#include <maya/MSceneMessage.h>
+#include <maya/MAnimMessage.h>
+#include <maya/MThreadPool.h>
+#include <maya/MThreadUtils.h>
+#include <maya/MTimer.h>
+
+#include <vector>
+
+#include "autoCompress.h"
+#include "keyReducerCmd.h"
+
+/*
+ AUTO COMPRESS
+ */
+
+bool AutoCompress::enabled = false;
+double AutoCompress::deviation = 0.5;
+MString AutoCompress::curveNamespace;
+bool AutoCompress::dirtyCurves = false;
+double AutoCompress::timeBudget = 0.0;
+MCallbackIdArray AutoCompress::callbacks;
+std::map<std::string, CurveHash> AutoCompress::compressedCurves;
+std::map<unsigned int, MObjectHandle> AutoCompress::editedCurves;
+
+MStatus AutoCompress::addCallbacks()
+{
+    MStatus status;
+    callbacks.append(MSceneMessage::addCallback(MSceneMessage::kBeforeSave, beforeSave, NULL, &status));
+    if (!status)
+        return status;
+
+    callbacks.append(MSceneMessage::addCallback(MSceneMessage::kBeforeExport, beforeSave, NULL, &status));
+    if (!status)
+        return status;
+
+    callbacks.append(MAnimMessage::addAnimCurveEditedCallback(curvesEdited, NULL, &status));
+    return status;
+}
+
+void AutoCompress::removeCallbacks()
+{
+    if (callbacks.length() != 0)
+        MMessage::removeCallbacks(callbacks);
+    callbacks.clear();
+    editedCurves.clear();
+}
+
+void AutoCompress::loadSettings()
+{
+    bool exists;
+    int intValue = MGlobal::optionVarIntValue("tcKeyReducerAutoCompress", &exists);
+    if (exists)
+        enabled = intValue != 0;
+
+    double doubleValue = MGlobal::optionVarDoubleValue("tcKeyReducerAutoCompressValue", &exists);
+    if (exists)
+        deviation = doubleValue;
+
+    MString stringValue = MGlobal::optionVarStringValue("tcKeyReducerAutoCompressNamespace", &exists);
+    if (exists)
+        curveNamespace = stringValue;
+
+    intValue = MGlobal::optionVarIntValue("tcKeyReducerAutoCompressDirty", &exists);
+    if (exists)
+        dirtyCurves = intValue != 0;
+
+    doubleValue = MGlobal::optionVarDoubleValue("tcKeyReducerAutoCompressTimeBudget", &exists);
+    if (exists)
+        timeBudget = doubleValue;
+}
+
+void AutoCompress::saveSettings()
+{
+    MGlobal::setOptionVarValue("tcKeyReducerAutoCompress", enabled ? 1 : 0);
+    MGlobal::setOptionVarValue("tcKeyReducerAutoCompressValue", deviation);
+    MGlobal::setOptionVarValue("tcKeyReducerAutoCompressNamespace", curveNamespace);
+    MGlobal::setOptionVarValue("tcKeyReducerAutoCompressDirty", dirtyCurves ? 1 : 0);
+    MGlobal::setOptionVarValue("tcKeyReducerAutoCompressTimeBudget", timeBudget);
+}
+
+// runs as a command so the compression goes in the undo queue, the edits recorded before it
+// are then undone on the keys they were made on
+void AutoCompress::beforeSave(void *clientData)
+{
+    if (enabled)
+        MGlobal::executeCommand("tcKeyReducerAutoCompress -run", false, true);
+}
+
+// the compression edits the curves too, they come back here but their hash keeps them from being reduced again
+void AutoCompress::curvesEdited(MObjectArray &curves, void *clientData)
+{
+    for (unsigned int i = 0; i < curves.length(); ++i)
+    {
+        MObjectHandle handle(curves[i]);
+        editedCurves[handle.hashCode()] = handle;
+    }
+}
+
+static bool isFlaggedCurve(const MFnAnimCurve &fnCurve)
+{
+    if (!fnCurve.hasAttribute("tcAutoReduce"))
+        return false;
+
+    MStatus status;
+    MPlug plug = fnCurve.findPlug("tcAutoReduce", true, &status);
+    return status == MS::kSuccess && plug.asBool();
+}
+
+static bool isTimeInputCurve(const MFnAnimCurve &fnCurve)
+{
+    MFnAnimCurve::AnimCurveType type = fnCurve.animCurveType();
+    return type == MFnAnimCurve::kAnimCurveTA || type == MFnAnimCurve::kAnimCurveTL ||
+           type == MFnAnimCurve::kAnimCurveTT || type == MFnAnimCurve::kAnimCurveTU;
+}
+
+// timer is a copy of the one of the whole pass, each task reads its own
+class CompressJob
+{
+public:
+    MObject curve;
+    std::string name;
+    double deviation;
+    bool cached, skipped;
+    MTimer timer;
+    double timeBudget;
+    ReduceScratch scratch;
+};
+
+class CompressBatch
+{
+public:
+    std::vector<CompressJob> jobs;
+    unsigned int count;
+};
+
+static double elapsedTime(MTimer &timer)
+{
+    timer.endTimer();
+    return timer.elapsedTime();
+}
+
+// the tasks of a region can't be stopped, the ones starting once the budget is used are skipped
+// so only the reductions already running go over it
+static MThreadRetVal compressTask(void *data)
+{
+    CompressJob *job = (CompressJob *)data;
+    if (job->timeBudget > 0.0 && elapsedTime(job->timer) > job->timeBudget)
+    {
+        job->skipped = true;
+        return (MThreadRetVal)0;
+    }
+
+    reduceSamples(job->scratch.samples, job->deviation, job->scratch.keptKeys, job->scratch);
+    return (MThreadRetVal)0;
+}
+
+static void compressRegion(void *data, MThreadRootTask *root)
+{
+    CompressBatch *batch = (CompressBatch *)data;
+
+    for (unsigned int i = 0; i < batch->count; ++i)
+        if (!batch->jobs[i].cached)
+            MThreadPool::createTask(compressTask, &batch->jobs[i], root);
+
+    MThreadPool::executeAndJoin(root);
+}
+
+// a namespace matches the curves inside it and inside its children, given with or without the colon
+static bool isInNamespace(const std::string &name, const std::string &namespaceName)
+{
+    if (namespaceName.empty())
+        return false;
+
+    std::string prefix = namespaceName;
+    if (prefix[prefix.length() - 1] != ':')
+        prefix += ':';
+    return name.compare(0, prefix.length(), prefix) == 0;
+}
+
+void AutoCompress::compress(MAnimCurveChange &change)
+{
+    MTimer timer;
+    timer.beginTimer();
+
+    std::string namespaceName = curveNamespace.asChar();
+
+    // the deleted curves are forgotten
+    std::map<unsigned int, MObjectHandle>::iterator edited = editedCurves.begin();
+    while (edited != editedCurves.end())
+    {
+        if (edited->second.isValid())
+            ++edited;
+        else
+            editedCurves.erase(edited++);
+    }
+
+    std::vector<MObject> curves;
+    for (MItDependencyNodes it(MFn::kAnimCurve); !it.isDone(); it.next())
+    {
+        MObject curve = it.thisNode();
+        MFnAnimCurve fnCurve(curve);
+        if (fnCurve.numKeys() <= 2 || !isTimeInputCurve(fnCurve))
+            continue;
+
+        bool isEdited = dirtyCurves && editedCurves.find(MObjectHandle(curve).hashCode()) != editedCurves.end();
+        if (isEdited || isInNamespace(fnCurve.name().asChar(), namespaceName) || isFlaggedCurve(fnCurve))
+            curves.push_back(curve);
+    }
+
+    MThreadPool::init();
+
+    CompressBatch batch;
+    batch.jobs.resize(MThreadUtils::getNumThreads() > 0 ? MThreadUtils::getNumThreads() : 1);
+
+    unsigned int numCurves = 0;
+    unsigned int keysRemoved = 0;
+    bool outOfTime = false;
+    unsigned int next = 0;
+    while (next < curves.size() && !outOfTime)
+    {
+        // the scene scan and the snapshots count against the budget, a batch only starts if there is time left
+        if (timeBudget > 0.0 && elapsedTime(timer) > timeBudget)
+        {
+            outOfTime = true;
+            break;
+        }
+
+        batch.count = 0;
+        while (batch.count < batch.jobs.size() && next < curves.size())
+        {
+            CompressJob &job = batch.jobs[batch.count];
+            job.curve = curves[next++];
+
+            MFnAnimCurve fnCurve(job.curve);
+            job.name = fnCurve.name().asChar();
+            job.deviation = deviation;
+            snapshotKeys(fnCurve, 0, fnCurve.numKeys() - 1, job.scratch.samples);
+
+            // curves left as they were after their last compression are skipped
+            std::map<std::string, CurveHash>::const_iterator compressed = compressedCurves.find(job.name);
+            if (compressed != compressedCurves.end() && compressed->second == hashSamples(job.scratch.samples, deviation))
+            {
+                editedCurves.erase(MObjectHandle(job.curve).hashCode());
+                continue;
+            }
+
+            job.cached = ReductionCache::find(job.scratch.samples, deviation, job.scratch.keptKeys);
+            job.skipped = false;
+            job.timeBudget = timeBudget;
+            batch.count++;
+        }
+
+        if (batch.count == 0)
+            continue;
+
+        if (timeBudget > 0.0 && elapsedTime(timer) > timeBudget)
+        {
+            outOfTime = true;
+            break;
+        }
+
+        for (unsigned int i = 0; i < batch.count; ++i)
+            batch.jobs[i].timer = timer;
+        MThreadPool::newParallelRegion(compressRegion, &batch);
+
+        for (unsigned int i = 0; i < batch.count; ++i)
+        {
+            CompressJob &job = batch.jobs[i];
+            if (job.skipped || (timeBudget > 0.0 && elapsedTime(timer) > timeBudget))
+            {
+                outOfTime = true;
+                break;
+            }
+
+            if (!job.cached)
+                ReductionCache::insert(job.scratch.samples, deviation, job.scratch.keptKeys);
+
+            MIntArray keptKeys;
+            for (unsigned int k = 0; k < job.scratch.keptKeys.size(); ++k)
+                keptKeys.append(job.scratch.keptKeys[k]);
+
+            MFnAnimCurve fnCurve(job.curve);
+            unsigned int numKeys = fnCurve.numKeys();
+            applyReducedKeys(fnCurve, keptKeys, &change, job.scratch);
+            keysRemoved += numKeys - fnCurve.numKeys();
+            numCurves++;
+
+            snapshotKeys(fnCurve, 0, fnCurve.numKeys() - 1, job.scratch.samples);
+            compressedCurves[job.name] = hashSamples(job.scratch.samples, deviation);
+            editedCurves.erase(MObjectHandle(job.curve).hashCode());
+        }
+    }
+
+    MThreadPool::release();
+
+    MString message = "tcKeyReducer: removed ";
+    message += keysRemoved;
+    message += " keys from ";
+    message += numCurves;
+    message += " curves in ";
+    message += elapsedTime(timer);
+    message += " seconds.";
+    if (outOfTime)
+        message += " The time budget was used before all the curves were compressed.";
+    MGlobal::displayInfo(message);
+}
+
+/*
+ AUTO COMPRESS CMD
+ */
+
+void* AutoCompressCmd::creator()
+{
+	return new AutoCompressCmd;
+}
+
+AutoCompressCmd::AutoCompressCmd():
+    compressed(false)
+{
+}
+
+bool AutoCompressCmd::isUndoable() const
+{
+	return compressed;
+}
+
+MStatus AutoCompressCmd::undoIt()
+{
+    animCurveChange.undoIt();
+	return MS::kSuccess;
+}
+
+MStatus AutoCompressCmd::redoIt()
+{
+    animCurveChange.redoIt();
+	return MS::kSuccess;
+}
+
+
+MSyntax AutoCompressCmd::syntaxCreator()
+{
+    MSyntax syntax;
+
+    syntax.addFlag("-h", "-help", MSyntax::kNoArg);
+    syntax.addFlag("-e", "-enable", MSyntax::kBoolean);
+    syntax.addFlag("-v", "-value", MSyntax::kDouble);
+    syntax.addFlag("-ns", "-namespace", MSyntax::kString);
+    syntax.addFlag("-d", "-dirty", MSyntax::kBoolean);
+    syntax.addFlag("-tb", "-timeBudget", MSyntax::kDouble);
+    syntax.addFlag("-r", "-run", MSyntax::kNoArg);
+
+	return syntax;
+}
+
+
+MStatus AutoCompressCmd::doIt(const MArgList& args)
+{
+    MArgDatabase argData(syntax(), args);
+
+    if (argData.isFlagSet("-help"))
+    {
+        MGlobal::displayInfo("This command sets up the reduction of the animation curves when the scene is saved or exported. The settings are kept between sessions, they are not undoable. The reduction done by -run, or on save, can be undone.\n\t -enable: bool - reduce the curves before saving or exporting\n\t -value: float - the value used for the reduction. Default: 0.5\n\t -namespace: string - the curves in this namespace are reduced\n\t -dirty: bool - if on, every curve edited since it was last reduced is reduced\n\t -timeBudget: float - the maximum number of seconds spent reducing on each save, 0 means no limit. The curves already being reduced when it is used are finished but not applied\n\t -run: no arg, reduces the curves now\n\t Curves with a tcAutoReduce attribute set to true are always reduced.");
+        return MS::kSuccess;
+    }
+
+    if (argData.isFlagSet("-enable"))
+        argData.getFlagArgument("-enable", 0, AutoCompress::enabled);
+
+    if (argData.isFlagSet("-value"))
+        argData.getFlagArgument("-value", 0, AutoCompress::deviation);
+
+    if (argData.isFlagSet("-namespace"))
+        argData.getFlagArgument("-namespace", 0, AutoCompress::curveNamespace);
+
+    if (argData.isFlagSet("-dirty"))
+        argData.getFlagArgument("-dirty", 0, AutoCompress::dirtyCurves);
+
+    if (argData.isFlagSet("-timeBudget"))
+        argData.getFlagArgument("-timeBudget", 0, AutoCompress::timeBudget);
+
+    AutoCompress::saveSettings();
+
+    if (argData.isFlagSet("-run"))
+    {
+        AutoCompress::compress(animCurveChange);
+        compressed = true;
+    }
+
+	return MS::kSuccess;
+}
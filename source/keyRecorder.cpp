@@ -0,0 +1,216 @@
+#include <maya/MSelectionList.h>
+#include <maya/MFnAnimCurve.h>
+#include <maya/MAnimControl.h>
+#include <maya/MStringArray.h>
+
+#include <algorithm>
+#include <string>
+
+#include "keyRecorder.h"
+
+/*
+ KEY RECORDER CMD
+ */
+
+std::vector<RecordedCurve> KeyRecorderCmd::recordedCurves;
+
+void* KeyRecorderCmd::creator()
+{
+	return new KeyRecorderCmd;
+}
+
+KeyRecorderCmd::KeyRecorderCmd()
+{
+}
+
+bool KeyRecorderCmd::isUndoable() const
+{
+	return false;
+}
+
+
+MSyntax KeyRecorderCmd::syntaxCreator()
+{
+    MSyntax syntax;
+
+    syntax.addFlag("-h", "-help", MSyntax::kNoArg);
+    syntax.addFlag("-b", "-begin", MSyntax::kNoArg);
+    syntax.addFlag("-s", "-sample", MSyntax::kNoArg);
+    syntax.addFlag("-e", "-end", MSyntax::kNoArg);
+    syntax.addFlag("-v", "-value", MSyntax::kDouble);
+    syntax.addFlag("-t", "-time", MSyntax::kDouble);
+
+	return syntax;
+}
+
+
+MStatus KeyRecorderCmd::doIt(const MArgList& args)
+{
+    MArgDatabase argData(syntax(), args);
+
+    if (argData.isFlagSet("-help"))
+    {
+        MGlobal::displayInfo("This command records the given attributes on new animation curves, reducing them while recording. This command is not undoable.\n\t -begin: no arg, starts recording the attributes given as arguments, i.e. locator1.tx\n\t -value: float - with -begin, the value used for the reduction. Default: 0.5\n\t -sample: no arg, records the current value of the attributes\n\t -time: float - with -sample, the time of the sample. Default: the current time\n\t -end: no arg, stops recording and returns the names of the recorded curves");
+        return MS::kSuccess;
+    }
+
+    if (argData.isFlagSet("-begin"))
+    {
+        double deviation = 0.5;
+        if (argData.isFlagSet("-value"))
+            argData.getFlagArgument("-value", 0, deviation);
+
+        return begin(args, deviation);
+    }
+
+    dropDeletedCurves();
+    if (recordedCurves.empty())
+    {
+        MGlobal::displayError("tcKeyRecorder: nothing is being recorded, please run tcKeyRecorder -begin first.");
+        return MS::kFailure;
+    }
+
+    if (argData.isFlagSet("-sample"))
+    {
+        double time = MAnimControl::currentTime().as(MTime::uiUnit());
+        if (argData.isFlagSet("-time"))
+            argData.getFlagArgument("-time", 0, time);
+
+        sample(time);
+    }
+
+    if (argData.isFlagSet("-end"))
+        end();
+
+    return MS::kSuccess;
+}
+
+MStatus KeyRecorderCmd::begin(const MArgList &args, const double deviation)
+{
+    dropDeletedCurves();
+    if (!recordedCurves.empty())
+    {
+        MGlobal::displayError("tcKeyRecorder: a recording is already running, please run tcKeyRecorder -end first.");
+        return MS::kFailure;
+    }
+
+    MStatus status = MS::kSuccess;
+
+    std::vector<RecordedCurve> curves;
+    for (unsigned int nth = 0; nth < args.length(); nth++)
+    {
+        MString inputString = args.asString(nth, &status);
+        if (status == MStatus::kFailure)
+        {
+            MGlobal::displayError("tcKeyRecorder error while parsing arguments");
+            return status;
+        }
+
+        RecordedCurve recorded;
+        MSelectionList selection;
+        selection.add(inputString);
+        status = selection.getPlug(0, recorded.plug);
+        if (status != MStatus::kSuccess)
+        {
+            MGlobal::displayError("tcKeyRecorder error while parsing argument. Failed to find plug " + inputString + ".");
+            return status;
+        }
+
+        recorded.node = MObjectHandle(recorded.plug.node());
+        recorded.reducer.reset(deviation);
+        curves.push_back(recorded);
+    }
+
+    if (curves.empty())
+	{
+		MGlobal::displayError("tcKeyRecorder: Please specify at least one attribute.");
+		return MS::kFailure;
+	}
+
+    // the curves are not connected, the attributes keep following their live input while recording
+    for (unsigned int i = 0; i < curves.size(); ++i)
+    {
+        MFnAnimCurve fnCurve;
+        curves[i].curve = MObjectHandle(fnCurve.create(fnCurve.timedAnimCurveTypeForPlug(curves[i].plug)));
+
+        std::string name = curves[i].plug.name().asChar();
+        std::replace(name.begin(), name.end(), '.', '_');
+        fnCurve.setName(MString(name.c_str()) + "_recorded");
+    }
+
+    recordedCurves = curves;
+    return MS::kSuccess;
+}
+
+// a new scene or the deletion of the recorded nodes ends their recording, the recording is over
+// once none is left
+void KeyRecorderCmd::dropDeletedCurves()
+{
+    unsigned int numDropped = 0;
+    std::vector<RecordedCurve>::iterator it = recordedCurves.begin();
+    while (it != recordedCurves.end())
+    {
+        if (it->node.isValid() && it->curve.isValid())
+            ++it;
+        else
+        {
+            it = recordedCurves.erase(it);
+            numDropped++;
+        }
+    }
+
+    if (numDropped > 0)
+    {
+        MString message = "tcKeyRecorder: ";
+        message += (int)numDropped;
+        message += " recorded attributes or their curves were deleted, they are not recorded any more.";
+        MGlobal::displayWarning(message);
+    }
+}
+
+void KeyRecorderCmd::addKey(const RecordedCurve &recorded, const double time, const double value)
+{
+    MFnAnimCurve fnCurve(recorded.curve.object());
+    fnCurve.addKey(MTime(time, MTime::uiUnit()), value, MFnAnimCurve::kTangentLinear, MFnAnimCurve::kTangentLinear);
+}
+
+void KeyRecorderCmd::sample(const double time)
+{
+    double keyTime, keyValue;
+    for (unsigned int i = 0; i < recordedCurves.size(); ++i)
+    {
+        RecordedCurve &recorded = recordedCurves[i];
+        if (recorded.reducer.addSample(time, recorded.plug.asDouble(), keyTime, keyValue))
+            addKey(recorded, keyTime, keyValue);
+    }
+}
+
+void KeyRecorderCmd::end()
+{
+    MStringArray curveNames;
+    unsigned int numSamples = 0;
+    unsigned int numKeys = 0;
+
+    double keyTime, keyValue;
+    for (unsigned int i = 0; i < recordedCurves.size(); ++i)
+    {
+        RecordedCurve &recorded = recordedCurves[i];
+        if (recorded.reducer.finish(keyTime, keyValue))
+            addKey(recorded, keyTime, keyValue);
+
+        numSamples += recorded.reducer.numSamples;
+        numKeys += recorded.reducer.numKeys;
+        curveNames.append(MFnAnimCurve(recorded.curve.object()).name());
+    }
+
+    recordedCurves.clear();
+
+    MString message = "tcKeyRecorder: recorded ";
+    message += (int)numSamples;
+    message += " samples as ";
+    message += (int)numKeys;
+    message += " keys.";
+    MGlobal::displayInfo(message);
+
+    setResult(curveNames);
+}
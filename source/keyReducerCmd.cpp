@@ -5,8 +5,23 @@
 #include <maya/MAnimControl.h>
 #include <maya/MDGModifier.h>
 #include <maya/MVector.h>
+#include <maya/MThreadPool.h>
+#include <maya/MThreadUtils.h>
+#include <maya/MDoubleArray.h>
+#include <maya/MStringArray.h>
+#include <maya/MAnimMessage.h>
+#include <maya/MSceneMessage.h>
+#include <maya/MFnKeyframeDelta.h>
+#include <maya/MFnKeyframeDeltaAddRemove.h>
+#include <maya/MFnKeyframeDeltaMove.h>
+
+#include <math.h>
+#include <algorithm>
+#include <iterator>
 
 #include "keyReducerCmd.h"
+#include "reductionCache.h"
+#include "reducePipeline.h"
 
 
 MString doubleToMString(double value)
@@ -27,6 +42,12 @@ KeyReducerCmd::KeyReducerCmd()
 {
 }
 
+KeyReducerCmd::~KeyReducerCmd()
+{
+    for (unsigned int i = 0; i < budgetChanges.size(); ++i)
+        delete budgetChanges[i];
+}
+
 bool KeyReducerCmd::isUndoable() const
 {
 	return true;
@@ -42,6 +63,15 @@ MSyntax KeyReducerCmd::syntaxCreator()
 	syntax.addFlag("-et", "-endTime", MSyntax::kLong);
     syntax.addFlag("-h", "-help", MSyntax::kNoArg);
     syntax.addFlag("-pb", "-preBake", MSyntax::kNoArg);
+    syntax.addFlag("-ws", "-windowSize", MSyntax::kLong);
+    syntax.addFlag("-mk", "-maxKeys", MSyntax::kLong);
+    syntax.addFlag("-r", "-ratio", MSyntax::kDouble);
+    syntax.addFlag("-g", "-group", MSyntax::kNoArg);
+    syntax.addFlag("-ss", "-scratchStats", MSyntax::kNoArg);
+    syntax.addFlag("-inc", "-incremental", MSyntax::kNoArg);
+    syntax.addFlag("-cs", "-clearSources", MSyntax::kNoArg);
+    syntax.addFlag("-l", "-levels", MSyntax::kDouble);
+    syntax.makeFlagMultiUse("-levels");
 	
 	return syntax;
 }
@@ -53,7 +83,13 @@ MStatus KeyReducerCmd::doIt(const MArgList& args)
     
     if (argData.isFlagSet("-help"))
     {
-        MGlobal::displayInfo("This command reduce the keys for the given animated attributes of the selected objects.\n\t args: list fo strings - the list of object attributes to evaluate, i.e. locator1.tx \n\t -value: float - the value used for the reduction. Default: 0.5\n\t -startTime: int - if specified, the keys before this frame will be ignored\n\t -endTime: int - if specified, the keys after this frame will be ignored\n\t -preBake: no arg, if specified the curve will be baked before key reducing, this will remove any broken/weighted tangents from your animation curve.");
+        MGlobal::displayInfo("This command reduce the keys for the given animated attributes of the selected objects.\n\t args: list fo strings - the list of object attributes to evaluate, i.e. locator1.tx \n\t -value: float - the value used for the reduction. Default: 0.5\n\t -startTime: int - if specified, the keys before this frame will be ignored\n\t -endTime: int - if specified, the keys after this frame will be ignored\n\t -preBake: no arg, if specified the curve will be baked before key reducing, this will remove any broken/weighted tangents from your animation curve.\n\t -windowSize: int - if specified, curves with more keys than this are split in windows of this many keys which are reduced in parallel. Must be at least 3.\n\t -maxKeys: int - if specified, the value is ignored and each curve is reduced with the smallest value keeping at most this many keys. Returns the value and the error reached for each curve.\n\t -ratio: float - like -maxKeys, with the maximum number of keys given as a fraction of the keys of the curve, between 0 and 1\n\t -group: no arg, with -maxKeys or -ratio, one value is searched for all the curves so that the sum of their keys fits the budget. Returns that value and the biggest error reached.\n\t -scratchStats: no arg, prints how many times the working buffers reused across the curves had to grow and the most memory they held.\n\t -incremental: no arg, the first time a curve is reduced its keys are kept as its source. When it is reduced again after some edits, only the span between the unchanged keys around the edits is baked on the source frames and reduced, the rest of the curve is left as it is. The sources are forgotten when a scene is opened or a new one is created, a curve changed while the plugin was not watching is reduced again from scratch. Can't be used with -startTime, -endTime, -maxKeys or -ratio.\n\t -clearSources: no arg, forgets the sources kept by -incremental\n\t -levels: float, multi use - if specified, the curves are left as they are and a new curve named after each of them and the level index, i.e. animCurve1_lod0, is created for each value. All the levels come from a single reduction. Returns the names of the new curves. Can't be used with -windowSize, -maxKeys, -ratio, -incremental or -preBake.\n\t Curves already reduced with the same keys and value are read from the cache, see tcKeyReducerCache.");
+        return MS::kSuccess;
+    }
+
+    if (argData.isFlagSet("-clearSources"))
+    {
+        incrementalSources.clear();
         return MS::kSuccess;
     }
 
@@ -108,12 +144,124 @@ MStatus KeyReducerCmd::doIt(const MArgList& args)
     }
     
     preBake = argData.isFlagSet("-preBake");
+
+    windowSize = 0;
+    if (argData.isFlagSet("-windowSize"))
+    {
+        argData.getFlagArgument("-windowSize", 0, windowSize);
+        if (windowSize < 3)
+        {
+            MGlobal::displayError("tcKeyReducer: -windowSize must be at least 3.");
+            return MS::kFailure;
+        }
+    }
     
-    for (unsigned int i = 0; i < plugsList.length(); ++i)
-	{
-		MFnAnimCurve fnCurve(plugsList[i]);
-		keyReduce(fnCurve);
-	}
+    maxKeys = 0;
+    if (argData.isFlagSet("-maxKeys"))
+    {
+        argData.getFlagArgument("-maxKeys", 0, maxKeys);
+        if (maxKeys < 2)
+        {
+            MGlobal::displayError("tcKeyReducer: -maxKeys must be at least 2.");
+            return MS::kFailure;
+        }
+    }
+    
+    keyRatio = 0.0;
+    if (argData.isFlagSet("-ratio"))
+    {
+        argData.getFlagArgument("-ratio", 0, keyRatio);
+        if (keyRatio <= 0.0 || keyRatio > 1.0)
+        {
+            MGlobal::displayError("tcKeyReducer: -ratio must be greater than 0 and at most 1.");
+            return MS::kFailure;
+        }
+    }
+    
+    if (maxKeys > 0 && keyRatio > 0.0)
+    {
+        MGlobal::displayError("tcKeyReducer: -maxKeys and -ratio can't be used together.");
+        return MS::kFailure;
+    }
+    
+    if ((maxKeys > 0 || keyRatio > 0.0) && windowSize > 0)
+    {
+        MGlobal::displayError("tcKeyReducer: -windowSize can't be used with -maxKeys or -ratio.");
+        return MS::kFailure;
+    }
+    
+    bool incremental = argData.isFlagSet("-incremental");
+    if (incremental && (hasStartTime || hasEndTime || maxKeys > 0 || keyRatio > 0.0))
+    {
+        MGlobal::displayError("tcKeyReducer: -incremental can't be used with -startTime, -endTime, -maxKeys or -ratio.");
+        return MS::kFailure;
+    }
+    
+    levels.clear();
+    for (unsigned int i = 0; i < argData.numberOfFlagUses("-levels"); ++i)
+    {
+        MArgList levelArgs;
+        argData.getFlagArgumentList("-levels", i, levelArgs);
+        levels.push_back(levelArgs.asDouble(0));
+        if (levels.back() < 0.0)
+        {
+            MGlobal::displayError("tcKeyReducer: -levels can't be negative.");
+            return MS::kFailure;
+        }
+    }
+    
+    // the pre bake would edit the source curves, which -levels leaves as they are
+    if (!levels.empty() && (windowSize > 0 || maxKeys > 0 || keyRatio > 0.0 || incremental || preBake))
+    {
+        MGlobal::displayError("tcKeyReducer: -levels can't be used with -windowSize, -maxKeys, -ratio, -incremental or -preBake.");
+        return MS::kFailure;
+    }
+    
+    scratchAllocations = 0;
+    scratchPeakBytes = 0;
+    
+    if (!levels.empty())
+    {
+        MStringArray result;
+        levelsKeyReduce(plugsList, result);
+        setResult(result);
+    }
+    else if (maxKeys > 0 || keyRatio > 0.0)
+    {
+        MDoubleArray result;
+        budgetKeyReduce(plugsList, argData.isFlagSet("-group"), result);
+        setResult(result);
+    }
+    else if (incremental)
+    {
+        // the edits still queued are the animator's, the ones made here are not edits to reduce again
+        MAnimMessage::flushAnimKeyframeEditedCallbacks();
+        for (unsigned int i = 0; i < plugsList.length(); ++i)
+        {
+            MFnAnimCurve fnCurve(plugsList[i]);
+            incrementalKeyReduce(fnCurve);
+        }
+        
+        ignoreEdits = true;
+        MAnimMessage::flushAnimKeyframeEditedCallbacks();
+        ignoreEdits = false;
+    }
+    else
+    {
+        pipelineKeyReduce(plugsList);
+    }
+    
+    if (argData.isFlagSet("-scratchStats"))
+    {
+        MString message = "tcKeyReducer: the working buffers grew ";
+        message += (int)scratchAllocations;
+        message += " times over ";
+        message += (int)plugsList.length();
+        message += " curves, holding at most ";
+        message += (double)scratchPeakBytes / 1024.0;
+        message += " KB.";
+        MGlobal::displayInfo(message);
+    }
     
 	return MS::kSuccess;
 }
@@ -134,140 +282,307 @@ bool KeyReducerCmd::isBeforeEndTime(const MTime &time)
     return time.as(MTime::uiUnit()) <= endTime;
 }
 
-void KeyReducerCmd::addIndex(MIntArray &array, const int index)
+bool isSteppedKey(const MFnAnimCurve &fnCurve, const unsigned int index)
 {
-	for (unsigned int keysIndex = 0; keysIndex < array.length() - 1; ++keysIndex)
-		if (index > array[keysIndex] && index < array[keysIndex + 1])
-			array.insert(index, keysIndex + 1);
+    MFnAnimCurve::TangentType outTType = fnCurve.outTangentType(index);
+#if defined(MAYA2018)
+    return outTType == MFnAnimCurve::kTangentStep || outTType == MFnAnimCurve::kTangentStepNext;
+#else
+    return outTType == MFnAnimCurve::kTangentStep;
+#endif
 }
 
-int KeyReducerCmd::getIndexInArray(const MIntArray &array, const int &val)
+bool isStaticCurve(const MFnAnimCurve &fnCurve)
 {
-	for (unsigned int i = 0; i < array.length(); i++)
-		if (array[i] == val) return i;
-	return -1;
+    double firstValue = fnCurve.value(0);
+    for (unsigned int i = 1; i < fnCurve.numKeys(); ++i)
+        if (!isFlatValue(fnCurve.value(i), firstValue))
+            return false;
+    return true;
 }
 
-void KeyReducerCmd::getBoundaries(const MIntArray &keys, const MFnAnimCurve &fnCurve, const int &currentIndex, double &x1, double &y1,double &x2, double &y2)
+void snapshotKeys(const MFnAnimCurve &fnCurve, const unsigned int firstKey, const unsigned int lastKey, CurveSamples &samples)
 {
-	unsigned int keysIndex;
-	for (keysIndex = 0; keysIndex < keys.length() - 1; ++keysIndex)
-		if (currentIndex > keys[keysIndex] && currentIndex < keys[keysIndex + 1])
-            break;
-	
-	x1 = fnCurve.value(keys[keysIndex]);
-	y1 = fnCurve.time(keys[keysIndex]).as(MTime::uiUnit());
-	x2 = fnCurve.value(keys[keysIndex + 1]);
-	y2 = fnCurve.time(keys[keysIndex + 1]).as(MTime::uiUnit());
+    samples.clear();
+    samples.times.reserve(lastKey - firstKey + 1);
+    samples.values.reserve(lastKey - firstKey + 1);
+    samples.stepped.reserve(lastKey - firstKey + 1);
+    for (unsigned int i = firstKey; i <= lastKey; ++i)
+    {
+        samples.values.push_back(fnCurve.value(i));
+        samples.times.push_back(fnCurve.time(i).as(MTime::uiUnit()));
+        samples.stepped.push_back(isSteppedKey(fnCurve, i));
+    }
 }
 
-double KeyReducerCmd::getValue(const double &x1, const double &y1, const double &x2, const double &y2, const double &x3, const double &y3)
+void KeyReducerCmd::doKeyReduce(const MIntArray &sourceKeys, const MFnAnimCurve &fnCurve, MIntArray &outKeys)
 {
-	MVector p1(x1, y1);
-	MVector p2(x2, y2);
-	MVector p3(x3, y3);
-	
-	MVector vec = p2 - p1;
-	vec.normalize();
-	
-	double t = vec * (p3 - p1);
-	p3 = p3 - (p1 + t * vec);
-	
-	return fabs(p3.length());
+    if (windowSize > 0 && sourceKeys.length() > (unsigned int)windowSize)
+    {
+        doWindowedKeyReduce(sourceKeys, fnCurve, outKeys);
+        return;
+    }
+
+    CurveSamples &samples = scratch.samples;
+    snapshotKeys(fnCurve, sourceKeys[0], sourceKeys[sourceKeys.length() - 1], samples);
+
+    std::vector<int> &keptKeys = scratch.keptKeys;
+    if (!ReductionCache::find(samples, deviation, keptKeys))
+    {
+        reduceSamples(samples, deviation, keptKeys, scratch);
+        ReductionCache::insert(samples, deviation, keptKeys);
+    }
+
+    for (unsigned int i = 0; i < keptKeys.size(); ++i)
+        outKeys.append(sourceKeys[keptKeys[i]]);
 }
 
-void KeyReducerCmd::doKeyReduce(const MIntArray &sourceKeys, const MFnAnimCurve &fnCurve, MIntArray &outKeys)
+/*
+ WINDOWED REDUCTION
+ */
+
+class ReduceWindow
 {
-	outKeys.append(sourceKeys[0]);
-	outKeys.append(sourceKeys[sourceKeys.length() - 1]);
-	
-	double currentDeviation = 1000000000;
-	int currentIndex;
-	while (currentDeviation > deviation && sourceKeys.length() != outKeys.length())
-	{
-		currentDeviation = 0;
-		currentIndex = 0;
-		
-		for (unsigned int i = 1; i < sourceKeys.length() - 1; ++i)
-		{
-			if (getIndexInArray(outKeys, sourceKeys[i]) == -1)
-			{
-				double x1, y1, x2, y2;
-				getBoundaries(outKeys, fnCurve, sourceKeys[i], x1, y1, x2, y2);
-				
-				double val = fnCurve.value(sourceKeys[i]);
-                double time = fnCurve.time(sourceKeys[i]).as(MTime::uiUnit());
-				double thisDeviation = getValue(x1, y1, x2, y2, val, time);
-				if (thisDeviation > currentDeviation)
-				{
-					currentDeviation = thisDeviation;
-					currentIndex = sourceKeys[i];
-				}
-			}
-		}
-		
-		if (currentDeviation > deviation)
-			addIndex(outKeys, currentIndex);
-	}
+public:
+    unsigned int first, last;
+    double deviation;
+    bool cached;
+    ReduceScratch *scratch;
+};
+
+class ReduceWindowBatch
+{
+public:
+    std::vector<ReduceWindow> windows;
+    unsigned int count;
+};
+
+static MThreadRetVal reduceWindowTask(void *data)
+{
+    ReduceWindow *window = (ReduceWindow *)data;
+    reduceSamples(window->scratch->samples, window->deviation, window->scratch->keptKeys, *window->scratch);
+    return (MThreadRetVal)0;
+}
+
+static void reduceWindowsRegion(void *data, MThreadRootTask *root)
+{
+    ReduceWindowBatch *batch = (ReduceWindowBatch *)data;
+
+    for (unsigned int i = 0; i < batch->count; ++i)
+        if (!batch->windows[i].cached)
+            MThreadPool::createTask(reduceWindowTask, &batch->windows[i], root);
+
+    MThreadPool::executeAndJoin(root);
+}
+
+// The end of the last window appended to a curve, from its last kept key before the seam to the seam.
+// When the window kept only its ends and its first key was dropped as a seam, the first sample
+// of the tail is not a kept key any more and the next seam is kept.
+class WindowSeam
+{
+public:
+    WindowSeam(): started(false), keptStart(false) {}
+
+    bool started, keptStart;
+    CurveSamples tail;
+};
+
+static bool isSteppedSample(const CurveSamples &samples, const unsigned int index)
+{
+    return !samples.stepped.empty() && samples.stepped[index];
 }
 
-void restoreTangents(const MFnAnimCurve &fnSource, MFnAnimCurve &fnDest)
+// the seam follows the rules of the pre-pass: a boundary between stepped and free spans is kept,
+// inside stepped spans only the pose changes are, inside free spans the keys out of tolerance are
+bool KeyReducerCmd::isSeamRedundant(const WindowSeam &seam, const CurveSamples &samples, const int nextKey)
 {
-    for (unsigned int index = 0; index < fnSource.numKeys(); ++index)
+    const CurveSamples &tail = seam.tail;
+    const unsigned int seamIndex = tail.size() - 1;
+    const bool steppedBefore = isSteppedSample(tail, seamIndex - 1);
+    const bool steppedAfter = isSteppedSample(samples, 0);
+    if (steppedBefore != steppedAfter)
+        return false;
+
+    if (steppedBefore)
+        return isFlatValue(tail.values[seamIndex], tail.values[seamIndex - 1]);
+
+    if (!seam.keptStart)
+        return false;
+
+    double x1 = tail.values[0];
+    double y1 = tail.times[0];
+    double x2 = samples.values[nextKey];
+    double y2 = samples.times[nextKey];
+
+    for (unsigned int i = 1; i < seamIndex; ++i)
+        if (getDeviation(x1, y1, x2, y2, tail.values[i], tail.times[i]) > deviation)
+            return false;
+
+    for (int i = 0; i < nextKey; ++i)
+        if (getDeviation(x1, y1, x2, y2, samples.values[i], samples.times[i]) > deviation)
+            return false;
+
+    return true;
+}
+
+void KeyReducerCmd::appendWindowKeys(const int firstKey, const CurveSamples &samples, const std::vector<int> &keptKeys,
+                                     WindowSeam &seam, MIntArray &outKeys)
+{
+    unsigned int k = 0;
+    bool keptStart = true;
+
+    // the first key of a window is the last key of the previous one, only the samples of the
+    // two windows between its kept neighbours are checked
+    if (seam.started)
     {
-        MTime time = fnSource.time(index);
-        unsigned int keyID;
-        if (fnDest.find(time, keyID))
+        k = 1;
+        if (isSeamRedundant(seam, samples, keptKeys[1]))
         {
-#if defined(MAYA2018)
-			MFnAnimCurve::TangentValue inXTangentValue, inYTangentValue, outXTangentValue, outYTangentValue;
-#else
-			float inXTangentValue, inYTangentValue, outXTangentValue, outYTangentValue;
-#endif
-            fnSource.getTangent(index, inXTangentValue, inYTangentValue, true);
-            fnSource.getTangent(index, outXTangentValue, outYTangentValue, false);
-            
-            fnDest.setTangentsLocked(keyID, false);
-            fnDest.setWeightsLocked(keyID, false);
-            fnDest.setTangent(keyID, inXTangentValue, inYTangentValue, true, NULL, false);
-            fnDest.setTangent(keyID, outXTangentValue, outYTangentValue, false, NULL, false);
-            fnDest.setTangentsLocked(keyID, fnSource.tangentsLocked(index));
-            fnDest.setWeightsLocked(keyID, fnSource.weightsLocked(index));
+            outKeys.remove(outKeys.length() - 1);
+            keptStart = false;
         }
     }
+
+    for (; k < keptKeys.size(); ++k)
+        outKeys.append(firstKey + keptKeys[k]);
+
+    const unsigned int tailStart = keptKeys[keptKeys.size() - 2];
+    seam.started = true;
+    seam.keptStart = tailStart > 0 || keptStart;
+    seam.tail.times.assign(samples.times.begin() + tailStart, samples.times.end());
+    seam.tail.values.assign(samples.values.begin() + tailStart, samples.values.end());
+    seam.tail.stepped.assign(samples.stepped.begin() + (samples.stepped.empty() ? 0 : tailStart), samples.stepped.end());
+}
+
+void KeyReducerCmd::doWindowedKeyReduce(const MIntArray &sourceKeys, const MFnAnimCurve &fnCurve, MIntArray &outKeys)
+{
+    // consecutive windows share their boundary key, so every dropped key is checked
+    // against two kept keys of the same window and the tolerance holds across the seams.
+    // Only one batch of windows is held in memory at any time.
+    const unsigned int numKeys = sourceKeys.length();
+    const unsigned int step = windowSize - 1;
+
+    MThreadPool::init();
+
+    ReduceWindowBatch batch;
+    batch.windows.resize(MThreadUtils::getNumThreads() > 0 ? MThreadUtils::getNumThreads() : 1);
+
+    // every window of a batch runs on its own thread with its own buffers, kept for the next curves
+    if (windowScratch.size() < batch.windows.size())
+        windowScratch.resize(batch.windows.size());
+    for (unsigned int w = 0; w < batch.windows.size(); ++w)
+        batch.windows[w].scratch = &windowScratch[w];
+
+    WindowSeam seam;
+    unsigned int first = 0;
+    while (first < numKeys - 1)
+    {
+        batch.count = 0;
+        while (batch.count < batch.windows.size() && first < numKeys - 1)
+        {
+            ReduceWindow &window = batch.windows[batch.count];
+            window.first = first;
+            window.last = first + step < numKeys - 1 ? first + step : numKeys - 1;
+            window.deviation = deviation;
+            snapshotKeys(fnCurve, sourceKeys[window.first], sourceKeys[window.last], window.scratch->samples);
+            window.cached = ReductionCache::find(window.scratch->samples, deviation, window.scratch->keptKeys);
+
+            first = window.last;
+            batch.count++;
+        }
+
+        MThreadPool::newParallelRegion(reduceWindowsRegion, &batch);
+
+        for (unsigned int w = 0; w < batch.count; ++w)
+        {
+            ReduceWindow &window = batch.windows[w];
+            const std::vector<int> &keptKeys = window.scratch->keptKeys;
+            if (!window.cached)
+                ReductionCache::insert(window.scratch->samples, deviation, keptKeys);
+            window.scratch->updateStats();
+
+            appendWindowKeys(sourceKeys[window.first], window.scratch->samples, keptKeys, seam, outKeys);
+        }
+    }
+
+    MThreadPool::release();
+}
+
+/*
+ KEY TRANSFER
+ */
+
+// Everything needed to rebuild a key on another curve
+void readKey(const int index, const MFnAnimCurve &fnSource, KeyData &key)
+{
+    MTime time = fnSource.time(index);
+    key.time = time.value();
+    key.timeUnit = time.unit();
+    key.value = fnSource.value(index);
+    key.inTType = fnSource.inTangentType(index);
+    key.outTType = fnSource.outTangentType(index);
+    fnSource.getTangent(index, key.inXTangentValue, key.inYTangentValue, true);
+    fnSource.getTangent(index, key.outXTangentValue, key.outYTangentValue, false);
+    key.tangentsLocked = fnSource.tangentsLocked(index);
+    key.weightsLocked = fnSource.weightsLocked(index);
+}
+
+static unsigned int addKey(const KeyData &key, MFnAnimCurve &fnDest, MAnimCurveChange *change)
+{
+    return fnDest.addKey(MTime(key.time, (MTime::Unit)key.timeUnit), key.value,
+                         (MFnAnimCurve::TangentType)key.inTType, (MFnAnimCurve::TangentType)key.outTType, change);
+}
+
+// new keys come locked, they are unlocked to set the two tangents and locked back only if the source was
+static void writeTangents(const unsigned int index, const KeyData &key, MFnAnimCurve &fnDest, MAnimCurveChange *change)
+{
+    fnDest.setTangentsLocked(index, false);
+    fnDest.setWeightsLocked(index, false);
+    fnDest.setTangent(index, key.inXTangentValue, key.inYTangentValue, true, change, false);
+    fnDest.setTangent(index, key.outXTangentValue, key.outYTangentValue, false, change, false);
+    if (key.tangentsLocked)
+        fnDest.setTangentsLocked(index, true);
+    if (key.weightsLocked)
+        fnDest.setWeightsLocked(index, true);
 }
 
 void copyKey(const int index, const MFnAnimCurve &fnSource, MFnAnimCurve &fnDest,  MAnimCurveChange  *change)
 {
-	MTime time = fnSource.time(index);
-	double val = fnSource.value(index);
-	
-	MFnAnimCurve::TangentType inTType = fnSource.inTangentType(index);
-	MFnAnimCurve::TangentType outTType = fnSource.outTangentType(index);
-    
-#if defined(MAYA2018)
-	MFnAnimCurve::TangentValue inXTangentValue, inYTangentValue, outXTangentValue, outYTangentValue;
-#else
-	float inXTangentValue, inYTangentValue, outXTangentValue, outYTangentValue;
-#endif
-	fnSource.getTangent(index, inXTangentValue, inYTangentValue, true);
-	fnSource.getTangent(index, outXTangentValue, outYTangentValue, false);
-	
-	unsigned int newKeyIndex = fnDest.addKey(time, val, inTType,  outTType, change);
-    fnDest.setTangentsLocked(newKeyIndex, false);
-    fnDest.setWeightsLocked(newKeyIndex, false);
-	fnDest.setTangent(newKeyIndex, inXTangentValue, inYTangentValue, true, change, false);
-	fnDest.setTangent(newKeyIndex, outXTangentValue, outYTangentValue, false, change, false);
-    fnDest.setTangentsLocked(newKeyIndex, fnSource.tangentsLocked(index));
-    fnDest.setWeightsLocked(newKeyIndex, fnSource.weightsLocked(index));
+    KeyData key;
+    readKey(index, fnSource, key);
+    writeTangents(addKey(key, fnDest, change), key, fnDest, change);
 }
 
-void copyKeys(const MIntArray &keys, const MFnAnimCurve &fnSource, MFnAnimCurve &fnDest, MAnimCurveChange  *change)
+// adding a key can change the automatic tangents of the keys around it, so every key is
+// added before any tangent is set. The keys are sorted, adding one never moves the ones
+// already added and the index addKey returns stays valid.
+static void addKeys(MFnAnimCurve &fnDest, MAnimCurveChange *change, ReduceScratch &scratch)
 {
-	for (unsigned int i = 0; i < keys.length(); ++i)
-		copyKey(keys[i], fnSource, fnDest,  change);
-    
-    restoreTangents(fnSource, fnDest);
+    const unsigned int numKeys = scratch.keyData.size();
+    scratch.newKeyIndexes.resize(numKeys);
+    for (unsigned int i = 0; i < numKeys; ++i)
+        scratch.newKeyIndexes[i] = addKey(scratch.keyData[i], fnDest, change);
+
+    for (unsigned int i = 0; i < numKeys; ++i)
+        writeTangents(scratch.newKeyIndexes[i], scratch.keyData[i], fnDest, change);
+}
+
+void copyKeys(const MIntArray &keys, const MFnAnimCurve &fnSource, MFnAnimCurve &fnDest, MAnimCurveChange *change, ReduceScratch &scratch)
+{
+    scratch.keyData.resize(keys.length());
+    for (unsigned int i = 0; i < keys.length(); ++i)
+        readKey(keys[i], fnSource, scratch.keyData[i]);
+
+    addKeys(fnDest, change, scratch);
+}
+
+static void copyAllKeys(const MFnAnimCurve &fnSource, MFnAnimCurve &fnDest, MAnimCurveChange *change, ReduceScratch &scratch)
+{
+    scratch.keyData.resize(fnSource.numKeys());
+    for (unsigned int i = 0; i < scratch.keyData.size(); ++i)
+        readKey(i, fnSource, scratch.keyData[i]);
+
+    addKeys(fnDest, change, scratch);
 }
 
 bool aroundThisValue(const double thisValue, const double value, const double aroundValue)
@@ -310,12 +625,32 @@ void fixCurve(const MFnAnimCurve &fnSource,  MFnAnimCurve &fnDest)
 	}
 }
 
+void applyReducedKeys(MFnAnimCurve &curve, const MIntArray &keptKeys, MAnimCurveChange *change, ReduceScratch &scratch)
+{
+    MDGModifier modifier;
+	MFnAnimCurve tempCurve;
+	tempCurve.create(curve.animCurveType(), &modifier);
+    tempCurve.setIsWeighted(curve.isWeighted());
+
+    copyKeys(keptKeys, curve, tempCurve, NULL, scratch);
+	
+    fixCurve(curve, tempCurve);
+    
+    for (int i = keptKeys[keptKeys.length() - 1]; i >= keptKeys[0] ; --i)
+        curve.remove(i, change);
+    
+    copyAllKeys(tempCurve, curve, change, scratch);
+    
+    modifier.undoIt();
+}
+
 void KeyReducerCmd::sampleCurve(MFnAnimCurve &curve)
 {
     int min = hasStartTime? startTime: curve.time(0).as(MTime::uiUnit());
     int max = hasEndTime? endTime: curve.time(curve.numKeys() - 1).as(MTime::uiUnit());
     
-    std::vector<double> values;
+    std::vector<double> &values = scratch.values;
+    values.clear();
     values.reserve(int(max - min + 1));
     
     for (double i = min; i <= max ; ++i)
@@ -338,9 +673,11 @@ void KeyReducerCmd::sampleCurve(MFnAnimCurve &curve)
     }
 }
 
-void KeyReducerCmd::keyReduce(MFnAnimCurve &curve)
+bool KeyReducerCmd::collectKeys(MFnAnimCurve &curve, unsigned int &firstKey, unsigned int &numKeys)
 {
-    if (curve.numKeys() <= 2) return;
+    firstKey = 0;
+    numKeys = 0;
+    if (curve.numKeys() <= 2) return false;
     
     if (preBake)
     {
@@ -348,54 +685,713 @@ void KeyReducerCmd::keyReduce(MFnAnimCurve &curve)
         curve.setIsWeighted(false, &animCurveChange);
     }
     
-    MIntArray keyIndexes;
 	for (unsigned int i = 0; i < curve.numKeys(); ++i)
 	{
 		MTime time = curve.time(i);
 		if (isAfterStartTime(time) && isBeforeEndTime(time))
-			keyIndexes.append(i);
+        {
+            if (numKeys == 0)
+                firstKey = i;
+            numKeys++;
+        }
 	}
     
-    if (keyIndexes.length() <= 2) return;
+    return numKeys > 2;
+}
+
+bool KeyReducerCmd::collectKeys(MFnAnimCurve &curve, MIntArray &keyIndexes)
+{
+    unsigned int firstKey, numKeys;
+    bool reduce = collectKeys(curve, firstKey, numKeys);
+    for (unsigned int i = 0; i < numKeys; ++i)
+        keyIndexes.append(firstKey + i);
     
-    MIntArray outKeys;
+    return reduce;
+}
+
+bool KeyReducerCmd::prepareCurve(MFnAnimCurve &curve, unsigned int &firstKey, unsigned int &numKeys)
+{
+    if (!collectKeys(curve, firstKey, numKeys)) return false;
     
-    MDGModifier modifier;
-	MFnAnimCurve tempCurve;
-	tempCurve.create(curve.animCurveType(), &modifier);
-    tempCurve.setIsWeighted(curve.isWeighted());
+    // a fully static curve only needs one key
+    if (numKeys == curve.numKeys() && isStaticCurve(curve))
+    {
+        for (int i = curve.numKeys() - 1; i > 0 ; --i)
+            curve.remove(i, &animCurveChange);
+        return false;
+    }
+    
+    return true;
+}
 
-    doKeyReduce(keyIndexes, curve, outKeys);
-    copyKeys(outKeys, curve, tempCurve, NULL);
-	
-    fixCurve(curve, tempCurve);
+bool KeyReducerCmd::prepareCurve(MFnAnimCurve &curve, MIntArray &keyIndexes)
+{
+    unsigned int firstKey, numKeys;
+    if (!prepareCurve(curve, firstKey, numKeys)) return false;
     
-    for (int i = curve.numKeys() - 1; i >= 0 ; --i)
-	{
-		MTime time = curve.time(i);
-		if (isAfterStartTime(time) && isBeforeEndTime(time))
-			curve.remove(i, &animCurveChange);
-	}
+    for (unsigned int i = 0; i < numKeys; ++i)
+        keyIndexes.append(firstKey + i);
+    
+    return true;
+}
+
+void KeyReducerCmd::updateScratchStats()
+{
+    scratch.updateStats();
+
+    scratchAllocations = scratch.allocations;
+    size_t bytes = scratch.reservedBytes;
+    for (unsigned int i = 0; i < windowScratch.size(); ++i)
+    {
+        scratchAllocations += windowScratch[i].allocations;
+        bytes += windowScratch[i].reservedBytes;
+    }
+
+    if (bytes > scratchPeakBytes)
+        scratchPeakBytes = bytes;
+}
+
+/*
+ PIPELINED REDUCTION
+ */
+
+// A curve in flight, the keys in the time range are read in windows
+class CurveJob
+{
+public:
+    CurveJob(): busy(false) {}
+
+    bool busy;
+    unsigned int plug;
+    MObject curve;
+    unsigned int firstKey, numKeys;
+
+    // position in the range of the first key of the next window to read
+    unsigned int nextWindow;
+
+    // tasks of the windows read and not written yet, in curve order
+    std::deque<unsigned int> windows;
+    MIntArray keptKeys;
+    WindowSeam seam;
+};
+
+void KeyReducerCmd::pipelineKeyReduce(const MPlugArray &plugs)
+{
+    // the main thread reads the next windows and writes back the ones the workers are done with
+    // while the workers reduce the others, when it has nothing to read or write it reduces too,
+    // or sleeps until a worker is done
+    const unsigned int numThreads = MThreadUtils::getNumThreads() > 0 ? MThreadUtils::getNumThreads() : 1;
+    if (windowScratch.size() < numThreads)
+        windowScratch.resize(numThreads);
+
+    // a couple of windows per worker in flight keep them busy, each task is released once its window is
+    // written so only this many windows are held in memory. A curve has at least one window in flight
+    // until it is written, there are never more curves than tasks.
+    std::vector<ReduceTask> tasks(2 * numThreads + 1);
+    std::vector<unsigned int> freeTasks;
+    for (unsigned int i = tasks.size(); i > 0; --i)
+        freeTasks.push_back(i - 1);
+
+    std::vector<CurveJob> jobs(tasks.size());
+    unsigned int numBusy = 0;
+
+    {
+        ReduceQueue queue(windowScratch);
+
+        unsigned int next = 0;
+        while (next < plugs.length() || numBusy > 0)
+        {
+            bool progress = false;
+
+            ReduceTask *task;
+            while (queue.popDone(task))
+            {
+                ReductionCache::insert(task->samples, task->deviation, task->keptKeys);
+                task->done = true;
+                progress = true;
+            }
+
+            for (unsigned int j = 0; j < jobs.size(); ++j)
+            {
+                if (!jobs[j].busy)
+                    continue;
+
+                progress = writeWindows(jobs[j], tasks, freeTasks) || progress;
+                if (!jobs[j].busy)
+                    numBusy--;
+            }
+
+            while (!freeTasks.empty())
+            {
+                // the curves in flight get the free tasks first, in selection order
+                CurveJob *job = NULL;
+                for (unsigned int j = 0; j < jobs.size(); ++j)
+                    if (jobs[j].busy && jobs[j].nextWindow < jobs[j].numKeys - 1 && (!job || jobs[j].plug < job->plug))
+                        job = &jobs[j];
+
+                if (!job)
+                {
+                    if (next == plugs.length())
+                        break;
+
+                    MFnAnimCurve fnCurve(plugs[next]);
+
+                    // a curve driving several of the plugs is read again only once it is written
+                    bool inFlight = false;
+                    for (unsigned int j = 0; j < jobs.size(); ++j)
+                    {
+                        inFlight = inFlight || (jobs[j].busy && jobs[j].curve == fnCurve.object());
+                        if (!jobs[j].busy)
+                            job = &jobs[j];
+                    }
+
+                    if (inFlight || !job)
+                        break;
+
+                    job->plug = next++;
+                    progress = true;
+                    if (!startJob(fnCurve, *job))
+                        continue;
+
+                    numBusy++;
+                }
+
+                readWindow(*job, tasks[freeTasks.back()], queue);
+                job->windows.push_back(freeTasks.back());
+                freeTasks.pop_back();
+                progress = true;
+            }
+
+            if (!progress)
+                queue.reduceOrWait(scratch);
+        }
+    }
+
+    updateScratchStats();
+}
+
+bool KeyReducerCmd::startJob(MFnAnimCurve &curve, CurveJob &job)
+{
+    if (!prepareCurve(curve, job.firstKey, job.numKeys)) return false;
+
+    job.busy = true;
+    job.curve = curve.object();
+    job.nextWindow = 0;
+    job.windows.clear();
+    job.keptKeys.clear();
+    job.seam = WindowSeam();
+
+    return true;
+}
+
+void KeyReducerCmd::readWindow(CurveJob &job, ReduceTask &task, ReduceQueue &queue)
+{
+    // long curves are split in windows as in doWindowedKeyReduce, the others are a single window
+    const unsigned int step = windowSize > 0 && job.numKeys > (unsigned int)windowSize ? windowSize - 1 : job.numKeys - 1;
+
+    task.first = job.nextWindow;
+    task.last = task.first + step < job.numKeys - 1 ? task.first + step : job.numKeys - 1;
+    task.deviation = deviation;
+    job.nextWindow = task.last;
+
+    MFnAnimCurve fnCurve(job.curve);
+    snapshotKeys(fnCurve, job.firstKey + task.first, job.firstKey + task.last, task.samples);
+    task.cached = ReductionCache::find(task.samples, deviation, task.keptKeys);
+    task.done = task.cached;
+    if (!task.done)
+        queue.push(&task);
+}
+
+bool KeyReducerCmd::writeWindows(CurveJob &job, std::vector<ReduceTask> &tasks, std::vector<unsigned int> &freeTasks)
+{
+    if (job.windows.empty() || !tasks[job.windows.front()].done)
+        return false;
+
+    MFnAnimCurve fnCurve(job.curve);
+    while (!job.windows.empty() && tasks[job.windows.front()].done)
+    {
+        const ReduceTask &task = tasks[job.windows.front()];
+        appendWindowKeys(job.firstKey + task.first, task.samples, task.keptKeys, job.seam, job.keptKeys);
+
+        freeTasks.push_back(job.windows.front());
+        job.windows.pop_front();
+    }
+
+    if (job.windows.empty() && job.nextWindow == job.numKeys - 1)
+    {
+        applyReducedKeys(fnCurve, job.keptKeys, &animCurveChange, scratch);
+        job.busy = false;
+    }
+
+    return true;
+}
+
+/*
+ INCREMENTAL REDUCTION
+ */
+
+std::map<std::string, IncrementalSource> KeyReducerCmd::incrementalSources;
+MCallbackIdArray KeyReducerCmd::callbacks;
+bool KeyReducerCmd::ignoreEdits = false;
+
+MStatus KeyReducerCmd::addCallbacks()
+{
+    MStatus status;
+    callbacks.append(MAnimMessage::addAnimKeyframeEditedCallback(keyframesEdited, NULL, &status));
+    if (!status)
+        return status;
+
+    callbacks.append(MSceneMessage::addCallback(MSceneMessage::kAfterNew, sceneChanged, NULL, &status));
+    if (!status)
+        return status;
+
+    callbacks.append(MSceneMessage::addCallback(MSceneMessage::kAfterOpen, sceneChanged, NULL, &status));
+    return status;
+}
+
+void KeyReducerCmd::removeCallbacks()
+{
+    if (callbacks.length() != 0)
+        MMessage::removeCallbacks(callbacks);
+    callbacks.clear();
+}
+
+// the sources are kept by curve name, a curve of the new scene with the same name is another curve
+void KeyReducerCmd::sceneChanged(void *clientData)
+{
+    incrementalSources.clear();
+}
+
+static void addEditedTime(IncrementalSource &source, const double time)
+{
+    if (!source.edited)
+    {
+        source.edited = true;
+        source.editStart = source.editEnd = time;
+    }
+    else
+    {
+        source.editStart = std::min(source.editStart, time);
+        source.editEnd = std::max(source.editEnd, time);
+    }
+}
+
+void KeyReducerCmd::keyframesEdited(MObjectArray &deltas, void *clientData)
+{
+    if (ignoreEdits || incrementalSources.empty())
+        return;
+    
+    const MTime::Unit uiUnit = MTime::uiUnit();
+    for (unsigned int i = 0; i < deltas.length(); ++i)
+    {
+        MStatus status;
+        MFnKeyframeDelta delta(deltas[i], &status);
+        if (!status)
+            continue;
+        
+        MObject curve = delta.paramCurve(&status);
+        if (!status || curve.isNull())
+            continue;
+        
+        MFnAnimCurve fnCurve(curve);
+        std::map<std::string, IncrementalSource>::iterator it = incrementalSources.find(fnCurve.name().asChar());
+        if (it == incrementalSources.end())
+            continue;
+        
+        IncrementalSource &source = it->second;
+        if (deltas[i].hasFn(MFn::kKeyframeDeltaAddRemove))
+        {
+            MFnKeyframeDeltaAddRemove addRemove(deltas[i]);
+            MFnKeyframeDeltaAddRemove::DeltaType deltaType = addRemove.deltaType();
+            if (deltaType == MFnKeyframeDeltaAddRemove::kAdded)
+                source.numKeys++;
+            else if (deltaType == MFnKeyframeDeltaAddRemove::kRemoved)
+                source.numKeys--;
+            addEditedTime(source, addRemove.time().as(uiUnit));
+        }
+        else if (deltas[i].hasFn(MFn::kKeyframeDeltaMove))
+        {
+            MFnKeyframeDeltaMove move(deltas[i]);
+            addEditedTime(source, move.previousTime().as(uiUnit));
+            addEditedTime(source, move.currentTime().as(uiUnit));
+        }
+        else
+        {
+            // values and tangents are edited in place, the edits not tied to a key touch the whole curve
+            unsigned int index = delta.keyIndex(&status);
+            if (status && index < fnCurve.numKeys())
+                addEditedTime(source, fnCurve.time(index).as(uiUnit));
+            else
+            {
+                addEditedTime(source, -HUGE_VAL);
+                addEditedTime(source, HUGE_VAL);
+            }
+        }
+    }
+}
+
+static bool isSameTime(const double a, const double b)
+{
+    return fabs(a - b) < 1.0e-6;
+}
+
+// replaces the samples from begin to end, end excluded, the ones after are only moved if the count changes
+static void replaceSpan(CurveSamples &samples, const unsigned int begin, const unsigned int end,
+                        const std::vector<double> &times, const std::vector<double> &values)
+{
+    const unsigned int numOld = end - begin;
+    const unsigned int numCommon = std::min(numOld, (unsigned int)times.size());
+    std::copy(times.begin(), times.begin() + numCommon, samples.times.begin() + begin);
+    std::copy(values.begin(), values.begin() + numCommon, samples.values.begin() + begin);
+    std::fill(samples.stepped.begin() + begin, samples.stepped.begin() + begin + numCommon, 0);
     
-    outKeys.clear();
-    for (unsigned int keysIndex = 0; keysIndex < tempCurve.numKeys(); ++keysIndex)
-		outKeys.append(keysIndex);
+    const unsigned int split = begin + numCommon;
+    if (numOld > numCommon)
+    {
+        samples.times.erase(samples.times.begin() + split, samples.times.begin() + end);
+        samples.values.erase(samples.values.begin() + split, samples.values.begin() + end);
+        samples.stepped.erase(samples.stepped.begin() + split, samples.stepped.begin() + end);
+    }
+    else if (times.size() > numCommon)
+    {
+        samples.times.insert(samples.times.begin() + split, times.begin() + numCommon, times.end());
+        samples.values.insert(samples.values.begin() + split, values.begin() + numCommon, values.end());
+        samples.stepped.insert(samples.stepped.begin() + split, times.size() - numCommon, 0);
+    }
+}
+
+void KeyReducerCmd::incrementalKeyReduce(MFnAnimCurve &curve)
+{
+    std::string name = curve.name().asChar();
+    std::map<std::string, IncrementalSource>::iterator it = incrementalSources.find(name);
+    if (it != incrementalSources.end() && it->second.deviation == deviation && it->second.numKeys == curve.numKeys())
+    {
+        reduceDirtySpan(curve, it->second);
+        it->second.numKeys = curve.numKeys();
+        return;
+    }
     
-    copyKeys(outKeys, tempCurve, curve, &animCurveChange);
+    // first reduction with this value, or the curve was changed without the edits being seen,
+    // the keys left by the pre bake are the source
+    IncrementalSource &source = incrementalSources[name];
+    source.deviation = deviation;
+    source.edited = false;
     
-    modifier.undoIt();
-     
+    curveKeys.clear();
+    bool reduce = prepareCurve(curve, curveKeys);
+    if (curve.numKeys() == 0)
+        source.dense.clear();
+    else
+        snapshotKeys(curve, 0, curve.numKeys() - 1, source.dense);
+    if (reduce)
+    {
+        reducedKeys.clear();
+        doKeyReduce(curveKeys, curve, reducedKeys);
+        applyReducedKeys(curve, reducedKeys, &animCurveChange, scratch);
+        updateScratchStats();
+    }
+    source.numKeys = curve.numKeys();
+}
+
+// Only the keys of the edited span and the two untouched keys around it are read
+void KeyReducerCmd::reduceDirtySpan(MFnAnimCurve &curve, IncrementalSource &source)
+{
+    if (!source.edited)
+        return;
+    source.edited = false;
+    
+    const unsigned int numKeys = curve.numKeys();
+    if (numKeys < 2)
+        return;
+    
+    // the nearest keys before and after the edits are untouched, or the ends of the curve
+    const MTime::Unit uiUnit = MTime::uiUnit();
+    unsigned int first = 0;
+    double firstTime = curve.time(0).as(uiUnit);
+    if (source.editStart > firstTime)
+    {
+        first = curve.findClosest(MTime(source.editStart, uiUnit));
+        firstTime = curve.time(first).as(uiUnit);
+        while (first > 0 && firstTime >= source.editStart)
+            firstTime = curve.time(--first).as(uiUnit);
+    }
+    
+    unsigned int last = numKeys - 1;
+    double lastTime = curve.time(last).as(uiUnit);
+    if (source.editEnd < lastTime)
+    {
+        last = curve.findClosest(MTime(source.editEnd, uiUnit));
+        lastTime = curve.time(last).as(uiUnit);
+        while (last < numKeys - 1 && lastTime <= source.editEnd)
+            lastTime = curve.time(++last).as(uiUnit);
+    }
+    
+    if (last <= first)
+    {
+        // keys were only removed from the ends of the curve
+        return;
+    }
+    
+    // the span is baked on the source frames and on the keys set by the animator
+    std::vector<double> &times = scratch.values;
+    times.clear();
+    std::vector<double>::iterator denseBegin = std::upper_bound(source.dense.times.begin(), source.dense.times.end(), firstTime);
+    std::vector<double>::iterator denseEnd = std::lower_bound(denseBegin, source.dense.times.end(), lastTime);
+    const unsigned int denseFirst = (unsigned int)(denseBegin - source.dense.times.begin());
+    const unsigned int denseLast = (unsigned int)(denseEnd - source.dense.times.begin());
+    
+    for (unsigned int i = first + 1; i < last; ++i)
+        times.push_back(curve.time(i).as(uiUnit));
+    const unsigned int numEdited = times.size();
+    times.insert(times.end(), denseBegin, denseEnd);
+    std::inplace_merge(times.begin(), times.begin() + numEdited, times.end());
+    times.erase(std::unique(times.begin(), times.end(), isSameTime), times.end());
+    
+    std::vector<double> values(times.size());
+    for (unsigned int i = 0; i < times.size(); ++i)
+        values[i] = curve.evaluate(MTime(times[i], uiUnit));
+    
+    for (int i = last - 1; i > (int)first; --i)
+        curve.remove(i, &animCurveChange);
+    
+    for (unsigned int i = 0; i < times.size(); ++i)
+        curve.addKeyframe(MTime(times[i], uiUnit), values[i], &animCurveChange);
+    
+    // the baked span replaces the source between the two untouched keys
+    replaceSpan(source.dense, denseFirst, denseLast, times, values);
+    
+    if (times.size() > 0)
+    {
+        curveKeys.clear();
+        for (unsigned int i = first; i <= first + times.size() + 1; ++i)
+            curveKeys.append(i);
+        
+        reducedKeys.clear();
+        doKeyReduce(curveKeys, curve, reducedKeys);
+        applyReducedKeys(curve, reducedKeys, &animCurveChange, scratch);
+        updateScratchStats();
+    }
+}
+
+/*
+ LEVELS
+ */
+
+void KeyReducerCmd::levelsKeyReduce(const MPlugArray &plugs, MStringArray &result)
+{
+    // the search goes as far as the finest level, every coarser level is a prefix of it
+    const double finest = *std::min_element(levels.begin(), levels.end());
+    
+    std::vector<MObject> levelCurves;
+    ReductionTradeOff tradeOff;
+    for (unsigned int i = 0; i < plugs.length(); ++i)
+    {
+        MFnAnimCurve fnCurve(plugs[i]);
+        curveKeys.clear();
+        if (!collectKeys(fnCurve, curveKeys))
+            continue;
+        
+        const unsigned int firstKey = curveKeys[0];
+        const unsigned int lastKey = curveKeys[curveKeys.length() - 1];
+        snapshotKeys(fnCurve, firstKey, lastKey, scratch.samples);
+        reductionTradeOff(scratch.samples, tradeOff, scratch, finest);
+        
+        for (unsigned int level = 0; level < levels.size(); ++level)
+        {
+            tradeOff.keysForLevel(levels[level], scratch.keptKeys);
+            
+            // the keys out of the time range are copied as they are
+            reducedKeys.clear();
+            for (unsigned int k = 0; k < firstKey; ++k)
+                reducedKeys.append(k);
+            for (unsigned int k = 0; k < scratch.keptKeys.size(); ++k)
+                reducedKeys.append(firstKey + scratch.keptKeys[k]);
+            for (unsigned int k = lastKey + 1; k < fnCurve.numKeys(); ++k)
+                reducedKeys.append(k);
+            
+            MFnAnimCurve levelCurve;
+            MObject levelObject = levelCurve.create(fnCurve.animCurveType(), &dgModifier);
+            levelCurve.setIsWeighted(fnCurve.isWeighted());
+            copyKeys(reducedKeys, fnCurve, levelCurve, NULL, scratch);
+            fixCurve(fnCurve, levelCurve);
+            
+            MString name = fnCurve.name() + "_lod";
+            name += (int)level;
+            dgModifier.renameNode(levelObject, name);
+            levelCurves.push_back(levelObject);
+        }
+        
+        updateScratchStats();
+    }
+    
+    dgModifier.doIt();
     
+    for (unsigned int i = 0; i < levelCurves.size(); ++i)
+        result.append(MFnDependencyNode(levelCurves[i]).name());
+}
+
+/*
+ KEY BUDGET
+ */
+
+unsigned int KeyReducerCmd::keyBudget(const unsigned int numKeys)
+{
+    if (maxKeys > 0)
+        return maxKeys;
+    
+    unsigned int budget = (unsigned int)floor(keyRatio * numKeys);
+    return budget > 2 ? budget : 2;
+}
+
+void KeyReducerCmd::budgetKeyReduce(const MPlugArray &plugs, const bool group, MDoubleArray &result)
+{
+    // one greedy pass per curve gives the error for every number of kept keys,
+    // the tolerance is picked from it and the curves are then reduced with it
+    const unsigned int numCurves = plugs.length();
+    std::vector<MIntArray> keyIndexes(numCurves);
+    std::vector<ReductionTradeOff> tradeOffs(numCurves);
+    std::vector<double> tolerances(numCurves, 0.0);
+    
+    unsigned int totalKeys = 0;
+    for (unsigned int i = 0; i < numCurves; ++i)
+    {
+        tradeOffs[i].minKeys = 0;
+        
+        MFnAnimCurve fnCurve(plugs[i]);
+        if (!prepareCurve(fnCurve, keyIndexes[i]))
+        {
+            keyIndexes[i].clear();
+            continue;
+        }
+        
+        snapshotKeys(fnCurve, keyIndexes[i][0], keyIndexes[i][keyIndexes[i].length() - 1], scratch.samples);
+        reductionTradeOff(scratch.samples, tradeOffs[i], scratch, 0.0);
+        tolerances[i] = tradeOffs[i].toleranceForKeys(keyBudget(keyIndexes[i].length()));
+        totalKeys += keyIndexes[i].length();
+    }
+    
+    // fixCurve can add hold keys on top of the reduction, when they push a curve over the budget
+    // its reduction is undone and the tolerance is tightened by as many keys
+    if (group)
+    {
+        const unsigned int budget = keyBudget(totalKeys);
+        unsigned int minKeys = 0;
+        for (unsigned int i = 0; i < numCurves; ++i)
+            if (keyIndexes[i].length() > 0)
+                minKeys += tradeOffs[i].minKeys;
+        
+        double groupError = 0.0;
+        unsigned int target = budget;
+        while (true)
+        {
+            double tolerance = groupTolerance(tradeOffs, target);
+            tolerances.assign(numCurves, tolerance);
+            
+            const unsigned int firstChange = budgetChanges.size();
+            unsigned int numKeys = 0, finalKeys = 0;
+            groupError = 0.0;
+            for (unsigned int i = 0; i < numCurves; ++i)
+            {
+                if (keyIndexes[i].length() == 0)
+                    continue;
+                
+                double error;
+                numKeys += tradeOffs[i].keysForTolerance(tolerance, error);
+                finalKeys += applyBudgetTolerance(plugs[i], keyIndexes[i], tolerance);
+                if (error > groupError)
+                    groupError = error;
+            }
+            
+            if (finalKeys <= budget || numKeys <= minKeys)
+            {
+                if (finalKeys > budget)
+                    MGlobal::displayWarning("tcKeyReducer: the flat, stepped and hold keys of the curves don't fit the key budget, they are all kept.");
+                break;
+            }
+            
+            undoBudgetChanges(firstChange);
+            const unsigned int excess = finalKeys - budget;
+            target = numKeys > minKeys + excess ? numKeys - excess : minKeys;
+        }
+        
+        result.append(tolerances.empty() ? 0.0 : tolerances[0]);
+        result.append(groupError);
+        return;
+    }
+    
+    for (unsigned int i = 0; i < numCurves; ++i)
+    {
+        double error = 0.0;
+        if (keyIndexes[i].length() > 0)
+        {
+            const unsigned int budget = keyBudget(keyIndexes[i].length());
+            unsigned int target = budget;
+            while (true)
+            {
+                tolerances[i] = tradeOffs[i].toleranceForKeys(target);
+                const unsigned int numKeys = tradeOffs[i].keysForTolerance(tolerances[i], error);
+                
+                const unsigned int firstChange = budgetChanges.size();
+                const unsigned int finalKeys = applyBudgetTolerance(plugs[i], keyIndexes[i], tolerances[i]);
+                if (finalKeys <= budget || numKeys <= tradeOffs[i].minKeys)
+                {
+                    if (finalKeys > budget)
+                        MGlobal::displayWarning("tcKeyReducer: the flat, stepped and hold keys of " + MFnAnimCurve(plugs[i]).name() + " don't fit the key budget, they are all kept.");
+                    break;
+                }
+                
+                undoBudgetChanges(firstChange);
+                const unsigned int excess = finalKeys - budget;
+                target = numKeys > tradeOffs[i].minKeys + excess ? numKeys - excess : tradeOffs[i].minKeys;
+            }
+        }
+        
+        result.append(tolerances[i]);
+        result.append(error);
+    }
+}
+
+unsigned int KeyReducerCmd::applyBudgetTolerance(const MPlug &plug, const MIntArray &keyIndexes, const double tolerance)
+{
+    MFnAnimCurve fnCurve(plug);
+    const unsigned int keysOutside = fnCurve.numKeys() - keyIndexes.length();
+    
+    deviation = tolerance;
+    reducedKeys.clear();
+    doKeyReduce(keyIndexes, fnCurve, reducedKeys);
+    
+    // recorded on its own so it can be undone if the curve ends up over the budget
+    budgetChanges.push_back(new MAnimCurveChange);
+    applyReducedKeys(fnCurve, reducedKeys, budgetChanges.back(), scratch);
+    updateScratchStats();
+    
+    return fnCurve.numKeys() - keysOutside;
+}
+
+void KeyReducerCmd::undoBudgetChanges(const unsigned int first)
+{
+    while (budgetChanges.size() > first)
+    {
+        budgetChanges.back()->undoIt();
+        delete budgetChanges.back();
+        budgetChanges.pop_back();
+    }
 }
 
 MStatus KeyReducerCmd::redoIt()
 {
 	animCurveChange.redoIt();
+    for (unsigned int i = 0; i < budgetChanges.size(); ++i)
+        budgetChanges[i]->redoIt();
+    dgModifier.doIt();
 	return MS::kSuccess;
 }
 
 MStatus KeyReducerCmd::undoIt()
 {
+    dgModifier.undoIt();
+    for (unsigned int i = budgetChanges.size(); i > 0; --i)
+        budgetChanges[i - 1]->undoIt();
     animCurveChange.undoIt();
 	return MS::kSuccess;
 }
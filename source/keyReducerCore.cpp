@@ -0,0 +1,486 @@
+#include <maya/MVector.h>
+
+#include <math.h>
+#include <algorithm>
+
+#include "keyReducerCore.h"
+
+
+static const double kFlatTolerance = 1.0e-6;
+
+void CurveSamples::clear()
+{
+    times.clear();
+    values.clear();
+    stepped.clear();
+}
+
+unsigned int CurveSamples::size() const
+{
+    return (unsigned int)times.size();
+}
+
+double getDeviation(const double &x1, const double &y1, const double &x2, const double &y2, const double &x3, const double &y3)
+{
+	MVector p1(x1, y1);
+	MVector p2(x2, y2);
+	MVector p3(x3, y3);
+
+	MVector vec = p2 - p1;
+	vec.normalize();
+
+	double t = vec * (p3 - p1);
+	p3 = p3 - (p1 + t * vec);
+
+	return fabs(p3.length());
+}
+
+bool isFlatValue(const double &a, const double &b)
+{
+    return fabs(a - b) <= kFlatTolerance;
+}
+
+/*
+ PRE-PASS
+ */
+
+enum SpanType
+{
+    kFreeSpan = 0,
+    kSteppedSpan
+};
+
+// scratch.kept marks each sample as free for the search, kept, or inside a hold
+enum SampleState
+{
+    kFreeSample = 0,
+    kKeptSample,
+    kHoldSample
+};
+
+// spanTypes[i] classifies the span between sample i and i + 1
+static void classifySpans(const CurveSamples &samples, std::vector<char> &spanTypes)
+{
+    const int numSamples = (int)samples.size();
+    spanTypes.assign(numSamples - 1, kFreeSpan);
+
+    if (!samples.stepped.empty())
+        for (int i = 0; i < numSamples - 1; ++i)
+            if (samples.stepped[i])
+                spanTypes[i] = kSteppedSpan;
+}
+
+// The samples inside a run of at least three holding the same value can't deviate more than its
+// ends, they are left out of the search. Whether the ends are kept is up to the search.
+static void markHolds(const CurveSamples &samples, const std::vector<char> &spanTypes, std::vector<char> &kept)
+{
+    const int numSamples = (int)samples.size();
+    int i = 0;
+    while (i < numSamples - 1)
+    {
+        int j = i;
+        while (j < numSamples - 1 && spanTypes[j] != kSteppedSpan && isFlatValue(samples.values[j + 1], samples.values[i]))
+            ++j;
+
+        if (j - i >= 2)
+        {
+            for (int k = i + 1; k < j; ++k)
+                kept[k] = kHoldSample;
+            i = j;
+        }
+        else
+            ++i;
+    }
+}
+
+static bool computeSegment(const CurveSamples &samples, const std::vector<char> &kept, const int start, const int end, ReduceSegment &segment)
+{
+    if (end - start < 2)
+        return false;
+
+    segment.start = start;
+    segment.end = end;
+    segment.index = -1;
+    segment.deviation = -1.0;
+
+    const double x1 = samples.values[start];
+    const double y1 = samples.times[start];
+    const double x2 = samples.values[end];
+    const double y2 = samples.times[end];
+    for (int i = start + 1; i < end; ++i)
+    {
+        if (kept[i] == kHoldSample)
+            continue;
+
+        double thisDeviation = getDeviation(x1, y1, x2, y2, samples.values[i], samples.times[i]);
+        if (thisDeviation > segment.deviation)
+        {
+            segment.deviation = thisDeviation;
+            segment.index = i;
+        }
+    }
+
+    return segment.index != -1;
+}
+
+/*
+ SCRATCH
+ */
+
+ReduceScratch::ReduceScratch():
+allocations(0),
+reservedBytes(0)
+{
+}
+
+template<class T> static void trackBuffer(const std::vector<T> &buffer, size_t &capacity, unsigned int &allocations, size_t &bytes)
+{
+    size_t newCapacity = buffer.capacity() * sizeof(T);
+    if (newCapacity > capacity)
+        allocations++;
+    capacity = newCapacity;
+    bytes += capacity;
+}
+
+void ReduceScratch::updateStats()
+{
+    capacities.resize(10, 0);
+    reservedBytes = 0;
+    trackBuffer(samples.times, capacities[0], allocations, reservedBytes);
+    trackBuffer(samples.values, capacities[1], allocations, reservedBytes);
+    trackBuffer(samples.stepped, capacities[2], allocations, reservedBytes);
+    trackBuffer(keptKeys, capacities[3], allocations, reservedBytes);
+    trackBuffer(values, capacities[4], allocations, reservedBytes);
+    trackBuffer(kept, capacities[5], allocations, reservedBytes);
+    trackBuffer(spanTypes, capacities[6], allocations, reservedBytes);
+    trackBuffer(segments, capacities[7], allocations, reservedBytes);
+    trackBuffer(keyData, capacities[8], allocations, reservedBytes);
+    trackBuffer(newKeyIndexes, capacities[9], allocations, reservedBytes);
+}
+
+/*
+ GREEDY SEARCH
+ */
+
+// keeps the samples decided by the pre-pass and queues the free blocks for the greedy search
+static void seedReduction(const CurveSamples &samples, ReduceScratch &scratch)
+{
+    const int numSamples = (int)samples.size();
+    std::vector<char> &kept = scratch.kept;
+    std::vector<ReduceSegment> &segments = scratch.segments;
+    kept.assign(numSamples, kFreeSample);
+
+    // a segment holds at least one sample that is not kept, so there are never more than half of them
+    segments.clear();
+    segments.reserve(numSamples / 2 + 1);
+
+    std::vector<char> &spanTypes = scratch.spanTypes;
+    classifySpans(samples, spanTypes);
+    markHolds(samples, spanTypes, kept);
+
+    // the boundaries of every block of spans of the same type are kept, free blocks are
+    // left to the greedy search and stepped blocks need every key changing the held value.
+    // Without stepped keys the whole curve is one free block, as in the plain greedy search.
+    ReduceSegment segment;
+    int blockStart = 0;
+    while (blockStart < numSamples - 1)
+    {
+        int blockEnd = blockStart + 1;
+        while (blockEnd < numSamples - 1 && spanTypes[blockEnd] == spanTypes[blockStart])
+            ++blockEnd;
+
+        kept[blockStart] = kKeptSample;
+        kept[blockEnd] = kKeptSample;
+
+        if (spanTypes[blockStart] == kFreeSpan)
+        {
+            if (computeSegment(samples, kept, blockStart, blockEnd, segment))
+            {
+                segments.push_back(segment);
+                std::push_heap(segments.begin(), segments.end());
+            }
+        }
+        else
+        {
+            for (int i = blockStart + 1; i < blockEnd; ++i)
+                if (!isFlatValue(samples.values[i], samples.values[i - 1]))
+                    kept[i] = kKeptSample;
+        }
+
+        blockStart = blockEnd;
+    }
+}
+
+// keeps the most deviating sample of the top segment and queues the two halves
+static void splitTopSegment(const CurveSamples &samples, ReduceScratch &scratch)
+{
+    std::vector<ReduceSegment> &segments = scratch.segments;
+    std::pop_heap(segments.begin(), segments.end());
+    ReduceSegment current = segments.back();
+    segments.pop_back();
+    scratch.kept[current.index] = kKeptSample;
+
+    ReduceSegment segment;
+    if (computeSegment(samples, scratch.kept, current.start, current.index, segment))
+    {
+        segments.push_back(segment);
+        std::push_heap(segments.begin(), segments.end());
+    }
+    if (computeSegment(samples, scratch.kept, current.index, current.end, segment))
+    {
+        segments.push_back(segment);
+        std::push_heap(segments.begin(), segments.end());
+    }
+}
+
+void reduceSamples(const CurveSamples &samples, const double deviation, std::vector<int> &outKeys)
+{
+    ReduceScratch scratch;
+    reduceSamples(samples, deviation, outKeys, scratch);
+}
+
+void reduceSamples(const CurveSamples &samples, const double deviation, std::vector<int> &outKeys, ReduceScratch &scratch)
+{
+    outKeys.clear();
+
+    const int numSamples = (int)samples.size();
+    if (numSamples == 0)
+        return;
+
+    if (numSamples < 3)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            outKeys.push_back(i);
+        return;
+    }
+
+    seedReduction(samples, scratch);
+
+    const std::vector<ReduceSegment> &segments = scratch.segments;
+    while (!segments.empty() && segments.front().deviation > deviation)
+        splitTopSegment(samples, scratch);
+
+    const std::vector<char> &kept = scratch.kept;
+    outKeys.reserve(std::count(kept.begin(), kept.end(), (char)kKeptSample));
+    for (int i = 0; i < numSamples; ++i)
+        if (kept[i] == kKeptSample)
+            outKeys.push_back(i);
+}
+
+/*
+ TRADE-OFF
+ */
+
+unsigned int ReductionTradeOff::keysForTolerance(const double tolerance, double &error) const
+{
+    error = 0.0;
+    for (unsigned int i = 0; i < errors.size(); ++i)
+    {
+        if (errors[i] <= tolerance)
+        {
+            error = errors[i];
+            return minKeys + i;
+        }
+    }
+
+    // only reached by negative tolerances, every sample the search can add is kept
+    return errors.empty() ? minKeys : minKeys + (unsigned int)errors.size() - 1;
+}
+
+void ReductionTradeOff::keysForLevel(const double tolerance, std::vector<int> &outKeys) const
+{
+    double error;
+    const unsigned int numSteps = keysForTolerance(tolerance, error) - minKeys;
+
+    outKeys.assign(seedKeys.begin(), seedKeys.end());
+    outKeys.insert(outKeys.end(), order.begin(), order.begin() + numSteps);
+    std::sort(outKeys.begin(), outKeys.end());
+}
+
+double ReductionTradeOff::toleranceForKeys(const unsigned int maxKeys) const
+{
+    if (errors.empty())
+        return 0.0;
+
+    double tolerance = errors[0];
+    for (unsigned int i = 1; i < errors.size() && minKeys + i <= maxKeys; ++i)
+        if (errors[i] < tolerance)
+            tolerance = errors[i];
+
+    return tolerance;
+}
+
+void reductionTradeOff(const CurveSamples &samples, ReductionTradeOff &tradeOff)
+{
+    ReduceScratch scratch;
+    reductionTradeOff(samples, tradeOff, scratch, 0.0);
+}
+
+void reductionTradeOff(const CurveSamples &samples, ReductionTradeOff &tradeOff, ReduceScratch &scratch, const double stopDeviation)
+{
+    tradeOff.errors.clear();
+    tradeOff.seedKeys.clear();
+    tradeOff.order.clear();
+
+    const int numSamples = (int)samples.size();
+    if (numSamples < 3)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            tradeOff.seedKeys.push_back(i);
+        tradeOff.minKeys = numSamples;
+        tradeOff.errors.push_back(0.0);
+        return;
+    }
+
+    seedReduction(samples, scratch);
+    for (int i = 0; i < numSamples; ++i)
+        if (scratch.kept[i] == kKeptSample)
+            tradeOff.seedKeys.push_back(i);
+    tradeOff.minKeys = (unsigned int)tradeOff.seedKeys.size();
+
+    // the search stops at the first count whose error is within the tolerance,
+    // so the same steps are recorded here until nothing is left above stopDeviation
+    tradeOff.errors.reserve(numSamples - tradeOff.minKeys + 1);
+    tradeOff.order.reserve(numSamples - tradeOff.minKeys);
+    while (!scratch.segments.empty() && scratch.segments.front().deviation > stopDeviation)
+    {
+        tradeOff.errors.push_back(scratch.segments.front().deviation);
+        tradeOff.order.push_back(scratch.segments.front().index);
+        splitTopSegment(samples, scratch);
+    }
+    tradeOff.errors.push_back(scratch.segments.empty() ? 0.0 : scratch.segments.front().deviation);
+}
+
+double groupTolerance(const std::vector<ReductionTradeOff> &tradeOffs, const unsigned int maxKeys)
+{
+    std::vector<double> candidates;
+    for (unsigned int i = 0; i < tradeOffs.size(); ++i)
+        candidates.insert(candidates.end(), tradeOffs[i].errors.begin(), tradeOffs[i].errors.end());
+
+    if (candidates.empty())
+        return 0.0;
+
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // the total number of kept keys only goes down as the tolerance grows,
+    // look for the smallest candidate that fits the budget
+    unsigned int low = 0;
+    unsigned int high = (unsigned int)candidates.size() - 1;
+    while (low < high)
+    {
+        unsigned int middle = (low + high) / 2;
+        unsigned int numKeys = 0;
+        double error;
+        for (unsigned int i = 0; i < tradeOffs.size(); ++i)
+            numKeys += tradeOffs[i].keysForTolerance(candidates[middle], error);
+
+        if (numKeys <= maxKeys)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+
+    return candidates[low];
+}
+
+/*
+ STREAMING
+ */
+
+StreamReducer::StreamReducer(const double deviation)
+{
+    reset(deviation);
+}
+
+void StreamReducer::reset(const double newDeviation)
+{
+    deviation = newDeviation;
+    numSamples = 0;
+    numKeys = 0;
+    hasKey = false;
+    hasLast = false;
+    resetCone();
+}
+
+void StreamReducer::resetCone()
+{
+    // time always grows, so every direction from the key lies between 0 and pi
+    lowAngle = 0.0;
+    highAngle = M_PI;
+}
+
+bool StreamReducer::isInCone(const double angle) const
+{
+    return angle >= lowAngle && angle <= highAngle;
+}
+
+// the directions from the key whose line passes within the deviation of the sample
+void StreamReducer::narrowCone(const double time, const double value)
+{
+    const double dv = value - keyValue;
+    const double dt = time - keyTime;
+    const double distance = sqrt(dv * dv + dt * dt);
+    if (distance <= deviation)
+        return;
+
+    const double angle = atan2(dt, dv);
+    const double spread = asin(deviation / distance);
+    if (angle - spread > lowAngle)
+        lowAngle = angle - spread;
+    if (angle + spread < highAngle)
+        highAngle = angle + spread;
+}
+
+bool StreamReducer::addSample(const double time, const double value, double &outTime, double &outValue)
+{
+    if (numSamples > 0 && time <= lastTime)
+        return false;
+
+    numSamples++;
+
+    if (!hasKey)
+    {
+        hasKey = true;
+        keyTime = outTime = time;
+        keyValue = outValue = value;
+        lastTime = time;
+        lastValue = value;
+        numKeys++;
+        return true;
+    }
+
+    bool isKey = false;
+    if (hasLast && !isInCone(atan2(time - keyTime, value - keyValue)))
+    {
+        // the line can't reach this sample anymore, the previous one closes the segment
+        keyTime = outTime = lastTime;
+        keyValue = outValue = lastValue;
+        resetCone();
+        numKeys++;
+        isKey = true;
+    }
+
+    narrowCone(time, value);
+    lastTime = time;
+    lastValue = value;
+    hasLast = true;
+
+    return isKey;
+}
+
+bool StreamReducer::finish(double &outTime, double &outValue)
+{
+    bool isKey = hasLast;
+    if (isKey)
+    {
+        outTime = lastTime;
+        outValue = lastValue;
+        numKeys++;
+    }
+
+    hasKey = false;
+    hasLast = false;
+    resetCone();
+    return isKey;
+}
@@ -0,0 +1,312 @@
+#include <maya/MFnAnimCurve.h>
+#include <maya/MFnMessageAttribute.h>
+#include <maya/MFnNumericAttribute.h>
+#include <maya/MFnUnitAttribute.h>
+#include <maya/MAnimMessage.h>
+#include <maya/MPlugArray.h>
+#include <maya/MTime.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include "keyReducerNode.h"
+#include "keyReducerCmd.h"
+
+MTypeId KeyReducerNode::id(0x0012a940);
+
+MObject KeyReducerNode::inputCurve;
+MObject KeyReducerNode::tolerance;
+MObject KeyReducerNode::time;
+MObject KeyReducerNode::curveEdits;
+MObject KeyReducerNode::output;
+
+void* KeyReducerNode::creator()
+{
+	return new KeyReducerNode;
+}
+
+KeyReducerNode::KeyReducerNode():
+    editedCallback(0),
+    curveChanged(true),
+    samplesUnit(MTime::kInvalid),
+    hasReduction(false),
+    reductionTolerance(0.0),
+    weighted(false),
+    secondsPerUnit(1.0)
+{
+}
+
+KeyReducerNode::~KeyReducerNode()
+{
+    if (editedCallback)
+        MMessage::removeCallback(editedCallback);
+}
+
+void KeyReducerNode::postConstructor()
+{
+    MStatus status;
+    editedCallback = MAnimMessage::addAnimCurveEditedCallback(curveEdited, this, &status);
+    if (status != MS::kSuccess)
+    {
+        // without the callback the node can't know when to read the keys again
+        MGlobal::displayError("tcKeyReducerNode: could not register the anim curve edit callback");
+        editedCallback = 0;
+    }
+}
+
+MStatus KeyReducerNode::initialize()
+{
+    MFnMessageAttribute mAttr;
+    MFnNumericAttribute nAttr;
+    MFnUnitAttribute uAttr;
+
+    inputCurve = mAttr.create("inputCurve", "ic");
+    addAttribute(inputCurve);
+
+    tolerance = nAttr.create("tolerance", "tol", MFnNumericData::kDouble, 0.5);
+    nAttr.setKeyable(true);
+    nAttr.setMin(0.0);
+    addAttribute(tolerance);
+
+    time = uAttr.create("time", "t", MFnUnitAttribute::kTime, 0.0);
+    uAttr.setKeyable(true);
+    addAttribute(time);
+
+    curveEdits = nAttr.create("curveEdits", "ced", MFnNumericData::kInt, 0);
+    nAttr.setHidden(true);
+    nAttr.setStorable(false);
+    addAttribute(curveEdits);
+
+    output = nAttr.create("output", "out", MFnNumericData::kDouble, 0.0);
+    nAttr.setWritable(false);
+    nAttr.setStorable(false);
+    addAttribute(output);
+
+    attributeAffects(inputCurve, output);
+    attributeAffects(tolerance, output);
+    attributeAffects(time, output);
+    attributeAffects(curveEdits, output);
+
+    return MS::kSuccess;
+}
+
+void KeyReducerNode::curveEdited(MObjectArray &editedCurves, void *clientData)
+{
+    KeyReducerNode *node = (KeyReducerNode *)clientData;
+
+    bool edited = false;
+    node->curveLock.lock();
+    for (unsigned int i = 0; i < editedCurves.length() && !node->sourceCurve.isNull(); ++i)
+        edited = edited || editedCurves[i] == node->sourceCurve;
+    if (edited)
+        node->curveChanged = true;
+    node->curveLock.unlock();
+
+    if (edited)
+    {
+        MPlug editsPlug(node->thisMObject(), curveEdits);
+        editsPlug.setValue(editsPlug.asInt() + 1);
+    }
+}
+
+MObject KeyReducerNode::connectedCurve()
+{
+    MPlugArray connections;
+    MPlug curvePlug(thisMObject(), inputCurve);
+    if (!curvePlug.connectedTo(connections, true, false) || connections.length() == 0)
+        return MObject::kNullObj;
+
+    MObject curve = connections[0].node();
+    if (!curve.hasFn(MFn::kAnimCurve))
+        return MObject::kNullObj;
+    return curve;
+}
+
+void KeyReducerNode::readCurve(const MObject &curve)
+{
+    samples.clear();
+    hasReduction = false;
+    samplesUnit = MTime::uiUnit();
+
+    if (curve.isNull())
+        return;
+
+    MFnAnimCurve fnCurve(curve);
+    if (fnCurve.numKeys() > 0)
+        snapshotKeys(fnCurve, 0, fnCurve.numKeys() - 1, samples);
+}
+
+void KeyReducerNode::reduceCurve(const double &toleranceValue)
+{
+    reduceSamples(samples, toleranceValue, keptKeys);
+
+    // only the kept keys need their tangents, the source did not change since the samples were read
+    MFnAnimCurve fnCurve(sourceCurve);
+    weighted = fnCurve.isWeighted();
+    secondsPerUnit = MTime(1.0, samplesUnit).as(MTime::kSeconds);
+
+    reducedKeys.resize(keptKeys.size());
+    reducedTimes.resize(keptKeys.size());
+    for (unsigned int i = 0; i < keptKeys.size(); ++i)
+    {
+        readKey(keptKeys[i], fnCurve, reducedKeys[i]);
+        reducedTimes[i] = samples.times[keptKeys[i]];
+    }
+
+    addHoldKeys();
+
+    reductionTolerance = toleranceValue;
+    hasReduction = true;
+}
+
+// Same test as fixCurve: a source key one frame away from a kept key, holding its value,
+// is added back when the reduced curve moves away from it
+void KeyReducerNode::addHoldKeys()
+{
+    std::vector<int> holdKeys;
+    for (unsigned int i = 0; i < keptKeys.size(); ++i)
+    {
+        const double keptValue = samples.values[keptKeys[i]];
+        for (int side = -1; side <= 1; side += 2)
+        {
+            const double holdTime = reducedTimes[i] + side;
+            std::vector<double>::const_iterator found = std::lower_bound(samples.times.begin(), samples.times.end(), holdTime);
+            if (found == samples.times.end() || *found != holdTime)
+                continue;
+            if (std::binary_search(reducedTimes.begin(), reducedTimes.end(), holdTime))
+                continue;
+
+            const int index = (int)(found - samples.times.begin());
+            const double holdValue = samples.values[index];
+            if (!aroundThisValue(evaluate(holdTime), holdValue, 0.0009) && aroundThisValue(holdValue, keptValue, 0.0009))
+                holdKeys.push_back(index);
+        }
+    }
+
+    if (holdKeys.empty())
+        return;
+
+    std::sort(holdKeys.begin(), holdKeys.end());
+    holdKeys.erase(std::unique(holdKeys.begin(), holdKeys.end()), holdKeys.end());
+
+    MFnAnimCurve fnCurve(sourceCurve);
+    std::vector<int> allKeys;
+    allKeys.reserve(keptKeys.size() + holdKeys.size());
+    std::merge(keptKeys.begin(), keptKeys.end(), holdKeys.begin(), holdKeys.end(), std::back_inserter(allKeys));
+
+    reducedKeys.resize(allKeys.size());
+    reducedTimes.resize(allKeys.size());
+    for (unsigned int i = 0; i < allKeys.size(); ++i)
+    {
+        readKey(allKeys[i], fnCurve, reducedKeys[i]);
+        reducedTimes[i] = samples.times[allKeys[i]];
+    }
+}
+
+double KeyReducerNode::evaluate(const double &t) const
+{
+    if (t <= reducedTimes.front())
+        return reducedKeys.front().value;
+    if (t >= reducedTimes.back())
+        return reducedKeys.back().value;
+
+    unsigned int next = (unsigned int)(std::upper_bound(reducedTimes.begin(), reducedTimes.end(), t) - reducedTimes.begin());
+    return evaluateSegment(next - 1, t);
+}
+
+static double bezier(const double &p0, const double &p1, const double &p2, const double &p3, const double &s)
+{
+    const double r = 1.0 - s;
+    return r * r * r * p0 + 3.0 * r * r * s * p1 + 3.0 * r * s * s * p2 + s * s * s * p3;
+}
+
+// Maya's interpolation between two keys: held after a stepped key, a Bezier segment on weighted
+// curves and a Hermite one, which only depends on the tangent slopes, on the others.
+// The tangents are three times the offset of the Bezier control points, their x in seconds.
+double KeyReducerNode::evaluateSegment(const unsigned int previous, const double &t) const
+{
+    const KeyData &start = reducedKeys[previous];
+    const KeyData &end = reducedKeys[previous + 1];
+
+    if (start.outTType == MFnAnimCurve::kTangentStep)
+        return start.value;
+#if defined(MAYA2018)
+    if (start.outTType == MFnAnimCurve::kTangentStepNext)
+        return end.value;
+#endif
+
+    const double startTime = reducedTimes[previous];
+    const double endTime = reducedTimes[previous + 1];
+    const double length = endTime - startTime;
+
+    if (!weighted)
+    {
+        const double span = length * secondsPerUnit;
+        const double outSlope = start.outXTangentValue != 0 ? start.outYTangentValue / start.outXTangentValue : 0.0;
+        const double inSlope = end.inXTangentValue != 0 ? end.inYTangentValue / end.inXTangentValue : 0.0;
+
+        const double s = (t - startTime) / length;
+        const double s2 = s * s;
+        const double s3 = s2 * s;
+        return (2.0 * s3 - 3.0 * s2 + 1.0) * start.value + (s3 - 2.0 * s2 + s) * outSlope * span +
+               (3.0 * s2 - 2.0 * s3) * end.value + (s3 - s2) * inSlope * span;
+    }
+
+    // the control points are kept inside the segment so the time stays monotonic
+    const double outTime = std::min(startTime + start.outXTangentValue / 3.0 / secondsPerUnit, endTime);
+    const double inTime = std::max(endTime - end.inXTangentValue / 3.0 / secondsPerUnit, startTime);
+    const double outValue = start.value + start.outYTangentValue / 3.0;
+    const double inValue = end.value - end.inYTangentValue / 3.0;
+
+    double low = 0.0, high = 1.0, s = 0.5;
+    for (unsigned int i = 0; i < 40; ++i)
+    {
+        s = (low + high) * 0.5;
+        if (bezier(startTime, outTime, inTime, endTime, s) < t)
+            low = s;
+        else
+            high = s;
+    }
+
+    return bezier(start.value, outValue, inValue, end.value, s);
+}
+
+MStatus KeyReducerNode::compute(const MPlug &plug, MDataBlock &data)
+{
+    if (plug != output)
+        return MS::kUnknownParameter;
+
+    double toleranceValue = data.inputValue(tolerance).asDouble();
+    double t = data.inputValue(time).asTime().as(MTime::uiUnit());
+    data.inputValue(curveEdits);
+
+    // the keys are only read again when the curve was edited, replaced, or the ui unit changed
+    // an edit arriving while the keys are read flags them again for the next compute
+    MObject curve = connectedCurve();
+    curveLock.lock();
+    bool read = curveChanged || !(curve == sourceCurve) || samplesUnit != MTime::uiUnit();
+    if (read)
+    {
+        sourceCurve = curve;
+        curveChanged = false;
+    }
+    curveLock.unlock();
+
+    if (read)
+        readCurve(curve);
+
+    MDataHandle outputHandle = data.outputValue(output);
+    if (samples.size() == 0)
+    {
+        outputHandle.set(0.0);
+        data.setClean(plug);
+        return MS::kSuccess;
+    }
+
+    if (!hasReduction || toleranceValue != reductionTolerance)
+        reduceCurve(toleranceValue);
+
+    outputHandle.set(evaluate(t));
+    data.setClean(plug);
+    return MS::kSuccess;
+}
@@ -0,0 +1,143 @@
+#include "reducePipeline.h"
+
+/*
+ QUEUE
+ */
+
+class ReduceWorker
+{
+public:
+    ReduceQueue *queue;
+    ReduceScratch *scratch;
+};
+
+ReduceQueue::ReduceQueue(std::vector<ReduceScratch> &scratches):
+    reducing(0),
+    numWorkers(0)
+{
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&changed, NULL);
+    for (unsigned int i = 0; i < scratches.size(); ++i)
+        freeScratches.push_back(&scratches[i]);
+}
+
+ReduceQueue::~ReduceQueue()
+{
+    // a worker can still be waiting in the pool even when every task is done
+    pthread_mutex_lock(&mutex);
+    while (numWorkers > 0)
+        pthread_cond_wait(&changed, &mutex);
+    pthread_mutex_unlock(&mutex);
+
+    pthread_cond_destroy(&changed);
+    pthread_mutex_destroy(&mutex);
+}
+
+void ReduceQueue::push(ReduceTask *task)
+{
+    ReduceWorker *worker = NULL;
+
+    pthread_mutex_lock(&mutex);
+    pending.push_back(task);
+    if (!freeScratches.empty())
+    {
+        worker = new ReduceWorker;
+        worker->queue = this;
+        worker->scratch = freeScratches.back();
+        freeScratches.pop_back();
+        numWorkers++;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (worker && !MThreadAsync::createTask(work, worker, workDone, NULL))
+    {
+        // the queued task is left to reduceOrWait
+        pthread_mutex_lock(&mutex);
+        freeScratches.push_back(worker->scratch);
+        numWorkers--;
+        pthread_mutex_unlock(&mutex);
+        delete worker;
+    }
+}
+
+void ReduceQueue::reduceOrWait(ReduceScratch &scratch)
+{
+    pthread_mutex_lock(&mutex);
+    ReduceTask *task = NULL;
+    if (!pending.empty())
+    {
+        task = pending.front();
+        pending.pop_front();
+        reducing++;
+    }
+    else
+    {
+        while (done.empty() && reducing > 0)
+            pthread_cond_wait(&changed, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (task)
+        reduce(task, scratch);
+}
+
+bool ReduceQueue::popDone(ReduceTask *&task)
+{
+    pthread_mutex_lock(&mutex);
+    bool found = !done.empty();
+    if (found)
+    {
+        task = done.front();
+        done.pop_front();
+    }
+    pthread_mutex_unlock(&mutex);
+
+    return found;
+}
+
+void ReduceQueue::reduce(ReduceTask *task, ReduceScratch &scratch)
+{
+    reduceSamples(task->samples, task->deviation, task->keptKeys, scratch);
+    scratch.updateStats();
+
+    pthread_mutex_lock(&mutex);
+    reducing--;
+    done.push_back(task);
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&mutex);
+}
+
+MThreadRetVal ReduceQueue::work(void *data)
+{
+    ReduceWorker *worker = (ReduceWorker *)data;
+    ReduceQueue *queue = worker->queue;
+
+    while (true)
+    {
+        pthread_mutex_lock(&queue->mutex);
+        if (queue->pending.empty())
+        {
+            // nothing touches the queue once the worker is gone, it can be destroyed
+            queue->freeScratches.push_back(worker->scratch);
+            queue->numWorkers--;
+            pthread_cond_broadcast(&queue->changed);
+            pthread_mutex_unlock(&queue->mutex);
+            break;
+        }
+
+        ReduceTask *task = queue->pending.front();
+        queue->pending.pop_front();
+        queue->reducing++;
+        pthread_mutex_unlock(&queue->mutex);
+
+        queue->reduce(task, *worker->scratch);
+    }
+
+    delete worker;
+    return (MThreadRetVal)0;
+}
+
+void ReduceQueue::workDone(void *data)
+{
+    // the workers report through the queue, there is nothing left to do once they return
+}
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <maya/MIntArray.h>
+
+#include "reductionCache.h"
+
+/*
+ HASH
+ */
+
+static const CurveHash kHashOffset = 14695981039346656037ULL;
+static const CurveHash kHashPrime = 1099511628211ULL;
+
+static void hashBytes(CurveHash &hash, const void *data, const size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= kHashPrime;
+    }
+}
+
+CurveHash hashSamples(const CurveSamples &samples, const double deviation)
+{
+    CurveHash hash = kHashOffset;
+    unsigned int numSamples = samples.size();
+    hashBytes(hash, &numSamples, sizeof(numSamples));
+    hashBytes(hash, &deviation, sizeof(deviation));
+    if (numSamples == 0)
+        return hash;
+
+    hashBytes(hash, &samples.times[0], numSamples * sizeof(double));
+    hashBytes(hash, &samples.values[0], numSamples * sizeof(double));
+    if (!samples.stepped.empty())
+        hashBytes(hash, &samples.stepped[0], numSamples * sizeof(char));
+
+    return hash;
+}
+
+/*
+ REDUCTION CACHE
+ */
+
+static const char kCacheMagic[4] = {'t', 'c', 'K', 'R'};
+static const unsigned int kCacheVersion = 1;
+
+unsigned int ReductionCache::capacity = 4096;
+unsigned int ReductionCache::hits = 0;
+unsigned int ReductionCache::misses = 0;
+MString ReductionCache::filePath;
+std::list<CachedReduction> ReductionCache::entries;
+std::map<CurveHash, std::list<CachedReduction>::iterator> ReductionCache::lookup;
+
+bool ReductionCache::find(const CurveSamples &samples, const double deviation, std::vector<int> &keptKeys)
+{
+    CurveHash hash = hashSamples(samples, deviation);
+    std::map<CurveHash, std::list<CachedReduction>::iterator>::iterator it = lookup.find(hash);
+    if (it == lookup.end() || it->second->numSamples != samples.size())
+    {
+        misses++;
+        return false;
+    }
+
+    // most recently used entries live at the front
+    entries.splice(entries.begin(), entries, it->second);
+    keptKeys = it->second->keptKeys;
+    hits++;
+    return true;
+}
+
+void ReductionCache::insert(const CurveSamples &samples, const double deviation, const std::vector<int> &keptKeys)
+{
+    if (capacity == 0)
+        return;
+
+    CurveHash hash = hashSamples(samples, deviation);
+    std::map<CurveHash, std::list<CachedReduction>::iterator>::iterator it = lookup.find(hash);
+    if (it != lookup.end())
+    {
+        entries.erase(it->second);
+        lookup.erase(it);
+    }
+
+    CachedReduction entry;
+    entry.hash = hash;
+    entry.numSamples = samples.size();
+    entry.keptKeys = keptKeys;
+    entries.push_front(entry);
+    lookup[hash] = entries.begin();
+
+    evict();
+}
+
+void ReductionCache::evict()
+{
+    while (entries.size() > capacity)
+    {
+        lookup.erase(entries.back().hash);
+        entries.pop_back();
+    }
+}
+
+void ReductionCache::clear()
+{
+    entries.clear();
+    lookup.clear();
+}
+
+void ReductionCache::resetStats()
+{
+    hits = 0;
+    misses = 0;
+}
+
+void ReductionCache::setCapacity(const unsigned int newCapacity)
+{
+    capacity = newCapacity;
+    evict();
+}
+
+// The kept keys of an entry read from a damaged or foreign file could point past the keys of the
+// curve it is applied to, such an entry is dropped
+static bool isValidReduction(const CachedReduction &entry)
+{
+    const unsigned int numKeptKeys = (unsigned int)entry.keptKeys.size();
+    if (numKeptKeys == 0 || entry.keptKeys[0] != 0 || entry.keptKeys[numKeptKeys - 1] != (int)entry.numSamples - 1)
+        return false;
+
+    for (unsigned int i = 1; i < numKeptKeys; ++i)
+        if (entry.keptKeys[i] <= entry.keptKeys[i - 1])
+            return false;
+    return true;
+}
+
+// The file only becomes the target of save() once it is known to be a cache file, so that a wrong
+// path given by mistake is never overwritten
+bool ReductionCache::setFile(const MString &path)
+{
+    if (path.length() == 0)
+    {
+        filePath = path;
+        return true;
+    }
+
+    FILE *file = fopen(path.asChar(), "rb");
+    if (!file)
+    {
+        filePath = path;
+        return true;
+    }
+
+    // a count bigger than what is left in the file is not allocated
+    fseek(file, 0, SEEK_END);
+    const long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char magic[4];
+    unsigned int version, numEntries;
+    if (fread(magic, sizeof(char), 4, file) != 4 || memcmp(magic, kCacheMagic, 4) != 0 ||
+        fread(&version, sizeof(version), 1, file) != 1 || version != kCacheVersion ||
+        fread(&numEntries, sizeof(numEntries), 1, file) != 1)
+    {
+        fclose(file);
+        return false;
+    }
+
+    std::list<CachedReduction> loadedEntries;
+    for (unsigned int i = 0; i < numEntries; ++i)
+    {
+        CachedReduction entry;
+        unsigned int numKeptKeys;
+        if (fread(&entry.hash, sizeof(entry.hash), 1, file) != 1 ||
+            fread(&entry.numSamples, sizeof(entry.numSamples), 1, file) != 1 ||
+            fread(&numKeptKeys, sizeof(numKeptKeys), 1, file) != 1 ||
+            numKeptKeys > entry.numSamples || (long)(numKeptKeys * sizeof(int)) > fileSize - ftell(file))
+            break;
+
+        entry.keptKeys.resize(numKeptKeys);
+        if (numKeptKeys > 0 && fread(&entry.keptKeys[0], sizeof(int), numKeptKeys, file) != numKeptKeys)
+            break;
+
+        if (isValidReduction(entry))
+            loadedEntries.push_back(entry);
+    }
+    fclose(file);
+
+    // the entries of this session stay the most recently used, the loaded ones follow them
+    filePath = path;
+    for (std::list<CachedReduction>::iterator it = loadedEntries.begin(); it != loadedEntries.end(); ++it)
+    {
+        if (lookup.find(it->hash) != lookup.end())
+            continue;
+
+        entries.push_back(*it);
+        lookup[it->hash] = --entries.end();
+    }
+
+    evict();
+    return true;
+}
+
+bool ReductionCache::save()
+{
+    if (filePath.length() == 0)
+        return false;
+
+    FILE *file = fopen(filePath.asChar(), "wb");
+    if (!file)
+        return false;
+
+    unsigned int numEntries = (unsigned int)entries.size();
+    fwrite(kCacheMagic, sizeof(char), 4, file);
+    fwrite(&kCacheVersion, sizeof(kCacheVersion), 1, file);
+    fwrite(&numEntries, sizeof(numEntries), 1, file);
+
+    for (std::list<CachedReduction>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+    {
+        unsigned int numKeptKeys = (unsigned int)it->keptKeys.size();
+        fwrite(&it->hash, sizeof(it->hash), 1, file);
+        fwrite(&it->numSamples, sizeof(it->numSamples), 1, file);
+        fwrite(&numKeptKeys, sizeof(numKeptKeys), 1, file);
+        if (numKeptKeys > 0)
+            fwrite(&it->keptKeys[0], sizeof(int), numKeptKeys, file);
+    }
+
+    bool success = ferror(file) == 0;
+    fclose(file);
+    return success;
+}
+
+/*
+ REDUCTION CACHE CMD
+ */
+
+void* ReductionCacheCmd::creator()
+{
+	return new ReductionCacheCmd;
+}
+
+ReductionCacheCmd::ReductionCacheCmd()
+{
+}
+
+bool ReductionCacheCmd::isUndoable() const
+{
+	return false;
+}
+
+
+MSyntax ReductionCacheCmd::syntaxCreator()
+{
+    MSyntax syntax;
+
+    syntax.addFlag("-h", "-help", MSyntax::kNoArg);
+    syntax.addFlag("-c", "-capacity", MSyntax::kLong);
+    syntax.addFlag("-f", "-file", MSyntax::kString);
+    syntax.addFlag("-s", "-save", MSyntax::kNoArg);
+    syntax.addFlag("-cl", "-clear", MSyntax::kNoArg);
+    syntax.addFlag("-st", "-stats", MSyntax::kNoArg);
+    syntax.addFlag("-rs", "-resetStats", MSyntax::kNoArg);
+
+	return syntax;
+}
+
+
+MStatus ReductionCacheCmd::doIt(const MArgList& args)
+{
+    MArgDatabase argData(syntax(), args);
+
+    if (argData.isFlagSet("-help"))
+    {
+        MGlobal::displayInfo("This command controls the cache of the tcKeyReducer results. Curves reduced again with the same keys and value are read from the cache. This command is not undoable.\n\t -capacity: int - the maximum number of cached curves. Default: 4096\n\t -file: string - the file the cache is loaded from and saved to, an empty string disables it. The loaded curves are added to the ones already cached, a file that is not a cache file is rejected and never overwritten\n\t -save: no arg, saves the cache to its file\n\t -clear: no arg, removes all the cached curves\n\t -stats: no arg, returns the hits, the misses and the number of cached curves\n\t -resetStats: no arg, resets the hits and misses counters");
+        return MS::kSuccess;
+    }
+
+    if (argData.isFlagSet("-clear"))
+        ReductionCache::clear();
+
+    if (argData.isFlagSet("-resetStats"))
+        ReductionCache::resetStats();
+
+    if (argData.isFlagSet("-capacity"))
+    {
+        int capacity;
+        argData.getFlagArgument("-capacity", 0, capacity);
+        if (capacity < 0)
+        {
+            MGlobal::displayError("tcKeyReducerCache: -capacity can't be negative.");
+            return MS::kFailure;
+        }
+        ReductionCache::setCapacity(capacity);
+    }
+
+    if (argData.isFlagSet("-file"))
+    {
+        MString path;
+        argData.getFlagArgument("-file", 0, path);
+        if (!ReductionCache::setFile(path))
+        {
+            MGlobal::displayError("tcKeyReducerCache: " + path + " is not a valid cache file.");
+            return MS::kFailure;
+        }
+    }
+
+    if (argData.isFlagSet("-save") && !ReductionCache::save())
+    {
+        MGlobal::displayError("tcKeyReducerCache: could not save the cache to \"" + ReductionCache::filePath + "\".");
+        return MS::kFailure;
+    }
+
+    if (argData.isFlagSet("-stats"))
+    {
+        MIntArray stats;
+        stats.append(ReductionCache::hits);
+        stats.append(ReductionCache::misses);
+        stats.append((int)ReductionCache::entries.size());
+        setResult(stats);
+    }
+
+	return MS::kSuccess;
+}